@@ -0,0 +1,65 @@
+// Copyright (C) 2024-2025  ilobilo
+
+#pragma once
+
+#include <stdint.h>
+
+// shared between the kernel and the vdso, both sides must agree on the layout
+
+#define VDSO_MAX_CPUS 256
+#define VDSO_PAGE_SIZE 0x1000
+
+// the data page, then one pvclock page per cpu. vdso.ld has to match
+#define VDSO_VVAR_PAGES (1 + VDSO_MAX_CPUS)
+
+enum vdso_clock_mode
+{
+    // every call goes to the kernel
+    vdso_mode_none = 0,
+    vdso_mode_tsc = 1,
+    vdso_mode_pvclock = 2
+};
+
+struct vdso_data
+{
+    // odd while the kernel is updating the page
+    uint32_t seq;
+    uint32_t mode;
+
+    // ((tsc * tsc_mult) >> tsc_shift) - cpu_offset[cpu]
+    uint64_t tsc_mult;
+    uint32_t tsc_shift;
+
+    // tsc_aux holds the cpu index, so rdtscp tells which cpu we are on
+    uint32_t has_tsc_aux;
+
+    // subtracted from the kvmclock system time
+    int64_t pvclock_offset;
+
+    // copy of time::state, turns the raw clock above into the clock ids
+    // mono = mono_last + (((raw - raw_last) * mult) >> 32)
+    uint64_t raw_last;
+    uint64_t mono_last;
+    uint64_t mult;
+    int64_t raw_offset;
+    int64_t realtime_offset;
+    uint64_t boot_offset;
+    uint64_t coarse_mono;
+
+    int64_t cpu_offset[VDSO_MAX_CPUS];
+};
+
+// written by the hypervisor, same as the kernel's kvmclock_info
+struct [[gnu::packed]] vdso_pvclock
+{
+    uint32_t version;
+    uint32_t pad0;
+    uint64_t tsc_timestamp;
+    uint64_t system_time;
+    uint32_t tsc_to_system_mul;
+    int8_t tsc_shift;
+    uint8_t flags;
+    uint8_t pad[2];
+};
+
+static_assert(sizeof(struct vdso_data) <= VDSO_PAGE_SIZE);
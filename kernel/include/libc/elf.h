@@ -182,4 +182,5 @@ typedef struct
 #define AT_ENTRY 9
 #define AT_SECURE 23
 #define AT_RANDOM 25
-#define AT_EXECFN 31
\ No newline at end of file
+#define AT_EXECFN 31
+#define AT_SYSINFO_EHDR 33
\ No newline at end of file
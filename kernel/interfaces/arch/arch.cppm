@@ -55,5 +55,8 @@ export namespace arch
     {
         void entry(std::uintptr_t addr);
         void bsp(std::uintptr_t addr);
+
+        // runs on the bsp once cpu idx has been started, alongside its entry()
+        void booting(std::size_t idx);
     } // namespace core
 } // export namespace arch
\ No newline at end of file
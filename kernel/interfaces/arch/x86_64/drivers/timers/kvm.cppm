@@ -12,6 +12,10 @@ export namespace x86_64::timers::kvm
     std::uint64_t time_ns();
     std::uint64_t tsc_freq();
 
+    // physical address of a cpu's pvclock page and the offset time_ns() subtracts
+    std::uintptr_t pvclock_page(std::size_t cpuidx);
+    std::int64_t clock_offset();
+
     void init_cpu();
 
     lib::initgraph::stage *initialised_stage();
@@ -1,9 +1,14 @@
 // Copyright (C) 2024-2025  ilobilo
 
 export module x86_64.drivers.timers.rtc;
+
+import lib;
 import cppstd;
 
 export namespace x86_64::timers::rtc
 {
-    // TODO
-} // export namespace x86_64::timers::rtc
\ No newline at end of file
+    // seconds since the epoch, read from the cmos clock
+    std::uint64_t time();
+
+    lib::initgraph::stage *initialised_stage();
+} // export namespace x86_64::timers::rtc
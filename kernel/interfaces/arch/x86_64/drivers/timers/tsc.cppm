@@ -15,6 +15,15 @@ export namespace x86_64::timers::tsc
     extern "C++" std::uint64_t rdtsc();
     std::uint64_t time_ns();
 
+    // offset time_ns() subtracts on a cpu
+    std::int64_t offset_of(std::size_t cpuidx);
+
+    // whether rdtscp is there. tsc_aux holds the cpu index if it is
+    bool aux_supported();
+
+    // checks for warps between the bsp and cpuidx while it runs init_cpu()
+    void sync_source(std::size_t cpuidx);
+
     void init_cpu();
     void finalise();
 
@@ -63,6 +63,8 @@ export namespace x86_64::idt
     [[nodiscard]]
     auto handler_at(std::size_t cpuidx, std::uint8_t num) -> std::optional<std::reference_wrapper<interrupts::handler>>;
 
+    std::size_t count_at(std::size_t cpuidx, std::uint8_t num);
+
     void init();
     void init_on(cpu::processor *cpu);
 } // namespace x86_64::idt
\ No newline at end of file
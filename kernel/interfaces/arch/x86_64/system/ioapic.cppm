@@ -36,5 +36,8 @@ export namespace x86_64::apic::io
     void mask(std::uint8_t vector);
     void unmask(std::uint8_t vector);
 
+    // changes only the destination, the mask state is kept
+    bool set_dest(std::uint8_t vector, std::size_t dest);
+
     void init();
 } // export namespace x86_64::apic::io
\ No newline at end of file
@@ -175,6 +175,30 @@ export namespace boot
     }
 
 
+    std::string_view cmdline()
+    {
+        static const std::string_view cached = [] {
+            return std::string_view { requests::kernel_file.response->executable_file->string };
+        } ();
+        return cached;
+    }
+
+    // value of a "key=value" option on the kernel command line
+    std::optional<std::string_view> cmdline_option(std::string_view key)
+    {
+        auto str = cmdline();
+        while (!str.empty())
+        {
+            const auto end = std::min(str.find(' '), str.size());
+            const auto option = str.substr(0, end);
+            str.remove_prefix(std::min(end + 1, str.size()));
+
+            if (option.size() > key.size() && option.starts_with(key) && option[key.size()] == '=')
+                return option.substr(key.size() + 1);
+        }
+        return std::nullopt;
+    }
+
     std::int64_t time()
     {
         static const auto cached = [] { return requests::boot_time.response->timestamp; } ();
@@ -4,6 +4,7 @@ export module drivers.fs;
 
 export import drivers.fs.dev;
 export import drivers.fs.devtmpfs;
+export import drivers.fs.procfs;
 export import drivers.fs.tmpfs;
 import lib;
 
@@ -0,0 +1,18 @@
+// Copyright (C) 2024-2025  ilobilo
+
+export module drivers.fs.procfs;
+
+import lib;
+import cppstd;
+
+export namespace fs::procfs
+{
+    // a read-only file in /proc whose contents are generated on every read
+    bool create(std::string_view name, std::function<std::string ()> generate);
+    // same, but writable by root. each write is passed to store, which
+    // returns false to fail it with EINVAL
+    bool create(std::string_view name, std::function<std::string ()> generate, std::function<bool (std::string_view)> store);
+
+    lib::initgraph::stage *registered_stage();
+    lib::initgraph::stage *mounted_stage();
+} // export namespace fs::procfs
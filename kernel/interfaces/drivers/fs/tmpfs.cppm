@@ -12,6 +12,8 @@ export namespace fs::tmpfs
     struct inode : vfs::inode
     {
         std::shared_ptr<vmm::object> memory;
+        int seals = vfs::f_seal_seal;
+
         inode(dev_t dev, ino_t ino, mode_t mode, std::shared_ptr<vfs::ops> op);
     };
 
@@ -30,6 +32,11 @@ export namespace fs::tmpfs
 
         std::shared_ptr<vmm::object> map(std::shared_ptr<vfs::file> file, bool priv) override;
 
+        int add_seals(std::shared_ptr<vfs::file> file, int seals) override;
+        int get_seals(std::shared_ptr<vfs::file> file) override;
+
+        int readdir(std::shared_ptr<vfs::file> file, vfs::dir_context &ctx) override;
+
         bool sync() override;
     };
 
@@ -56,5 +63,10 @@ export namespace fs::tmpfs
         fs() : vfs::filesystem { "tmpfs" } { }
     };
 
+    // an unlinked file on an internal instance, used by memfd_create
+    auto create_anonymous(std::string_view name, bool sealable, bool huge) -> vfs::expect<vfs::path>;
+    // same with its own ops and no file type, like timerfds
+    auto create_anonymous(std::string_view name, std::shared_ptr<vfs::ops> ops) -> vfs::expect<vfs::path>;
+
     lib::initgraph::stage *registered_stage();
 } // export namespace fs::tmpfs
\ No newline at end of file
@@ -26,6 +26,7 @@ export import :path;
 export import :ranged;
 export import :rbtree;
 export import :rwlock;
+export import :seqlock;
 export import :semaphore;
 export import :set;
 export import :spinlock;
@@ -9,7 +9,7 @@ import cppstd;
 
 namespace log
 {
-    constinit lib::spinlock_preempt _lock;
+    constinit lib::queued_spinlock_preempt _lock;
     std::uint64_t get_time();
 
     export namespace unsafe
@@ -179,6 +179,10 @@ export namespace lib
         }
 
         constexpr std::uint64_t frequency() const { return freq; }
+
+        // nanos(ticks) == (ticks * mult()) >> shift()
+        constexpr std::uint64_t mult() const { return n; }
+        constexpr int shift() const { return p; }
     };
 
     constexpr auto timestamp(std::uint16_t years, std::uint8_t months, std::uint8_t days, std::uint8_t hours, std::uint8_t minutes, std::uint8_t seconds)
@@ -2,20 +2,41 @@
 
 export module lib:mutex;
 
-import :semaphore;
+import system.scheduler.base;
 import :spinlock;
 import cppstd;
 
 export namespace lib
 {
+    // spins while the owner is running on another cpu, otherwise sleeps on
+    // an intrusive queue. unlock hands the mutex directly to the first waiter
     struct mutex
     {
         private:
-        spinlock _lock;
-        semaphore _sem;
+        struct waiter
+        {
+            sched::thread_base *thread;
+            waiter *next;
+            bool granted;
+        };
+
+        // owner thread, low bit set if there are waiters
+        static constexpr std::uintptr_t has_waiters = 1;
+        std::atomic_uintptr_t _owner;
+
+        spinlock _wait_lock;
+        waiter *_head;
+        waiter *_tail;
+
+        bool try_acquire(std::uintptr_t me);
+        bool spin_on_owner(std::uintptr_t me);
+
+        void lock_slow(std::uintptr_t me);
+        void unlock_slow();
 
         public:
-        mutex() : _lock { }, _sem { } { }
+        constexpr mutex()
+            : _owner { 0 }, _wait_lock { }, _head { nullptr }, _tail { nullptr } { }
 
         mutex(const mutex &) = delete;
         mutex(mutex &&) = delete;
@@ -23,38 +44,15 @@ export namespace lib
         mutex &operator=(const mutex &) = delete;
         mutex &operator=(mutex &&) = delete;
 
-        void lock()
-        {
-            if (is_locked())
-                _sem.wait();
-            _lock.lock();
-        }
-
-        bool unlock()
-        {
-            if (is_locked() == false)
-                return false;
-
-            _lock.unlock();
-            _sem.signal();
-            return true;
-        }
+        void lock();
+        bool unlock();
 
         bool is_locked() const
         {
-            return _lock.is_locked();
-        }
-
-        bool try_lock()
-        {
-            return _lock.try_lock();
+            return _owner.load(std::memory_order_relaxed) != 0;
         }
 
-        bool try_lock_until(std::uint64_t ns)
-        {
-            if (is_locked())
-                _sem.wait_for(ns / 1'000'000);
-            return try_lock();
-        }
+        bool try_lock();
+        bool try_lock_until(std::uint64_t ns);
     };
-} // export namespace lib
\ No newline at end of file
+} // export namespace lib
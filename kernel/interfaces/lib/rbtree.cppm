@@ -515,6 +515,27 @@ export namespace lib
             return ret == nil() ? nullptr : ret;
         }
 
+        // first item for which below returns false. below must be true for
+        // a prefix of the tree, like a key comparison
+        template<typename Func>
+        iterator lower_bound(Func below)
+        {
+            auto current = root();
+            auto ret = nil();
+            rbtree_hook nh;
+            while (current != nil())
+            {
+                if (below(*current))
+                    current = right(&nh, current);
+                else
+                {
+                    ret = current;
+                    current = left(&nh, current);
+                }
+            }
+            return { this, ret };
+        }
+
         bool contains(Type *x) const
         {
             auto current = root();
@@ -4,29 +4,111 @@ export module lib:rwlock;
 
 import :spinlock;
 import :mutex;
+import :semaphore;
 import :bug_on;
 import cppstd;
 
+namespace lib::lock
+{
+    std::size_t cpu_index();
+
+    // like acquire_irq and release_irq, but the old state is kept per cpu
+    void save_irq();
+    void restore_irq();
+
+    // false before the scheduler is up
+    bool can_sleep();
+} // namespace lib::lock
+
 export namespace lib
 {
-    template<lock_type Type>
+    // readers only touch the counter of their own cpu's shard. writers are
+    // serialised by a queued lock, announce themselves and wait for the sum
+    // of the shards to drain. readers that see a writer queue up behind it.
+    // the spinning variants keep preemption off while held, the blocking
+    // one parks the writer until the last reader leaves
+    template<lock_type Type, std::size_t Shards = 4>
     class rwlock_base
     {
         private:
-        std::size_t counter;
+        static constexpr bool blocking = (Type == lock_type::block);
+
+        struct no_waiters { };
+
+        // padded rather than aligned, the allocator ignores alignment
+        struct shard
+        {
+            std::atomic_ptrdiff_t count;
+            char pad[64 - sizeof(std::atomic_ptrdiff_t)];
+        };
+
+        // a reader may unlock on a different cpu than it locked on,
+        // so individual shards can go negative. only the sum matters
+        std::array<shard, Shards> _shards;
+        std::atomic_bool _writer;
 
-        std::conditional_t<
-            Type == lock_type::block,
-            mutex, spinlock_base<lock_type::spin>
-        > readers;
-        std::conditional_t<
-            Type == lock_type::block,
-            mutex, spinlock_base<Type>
-        > global;
+        std::conditional_t<blocking, mutex, queued_spinlock> _wlock;
+        // signalled by the reader that drains the shards under a writer
+        std::conditional_t<blocking, semaphore, no_waiters> _drained;
+
+        shard &local()
+        {
+            return _shards[lock::cpu_index() % Shards];
+        }
+
+        std::ptrdiff_t readers() const
+        {
+            std::ptrdiff_t sum = 0;
+            for (const auto &shard : _shards)
+                sum += shard.count.load(std::memory_order_seq_cst);
+            return sum;
+        }
+
+        // a preempted holder would leave a writer spinning on its cpu forever
+        void enter()
+        {
+            if constexpr (Type == lock_type::irq)
+                lock::save_irq();
+            else if constexpr (!blocking)
+                lock::acquire_preempt();
+        }
+
+        void leave()
+        {
+            if constexpr (Type == lock_type::irq)
+                lock::restore_irq();
+            else if constexpr (!blocking)
+                lock::release_preempt();
+        }
+
+        void reader_left()
+        {
+            if constexpr (blocking)
+            {
+                if (_writer.load(std::memory_order_seq_cst) && readers() == 0)
+                    _drained.signal();
+            }
+        }
+
+        void wait_for_readers(std::ptrdiff_t allowed)
+        {
+            // stale signals only cost an extra look at the shards
+            while (readers() != allowed)
+            {
+                if constexpr (blocking)
+                {
+                    if (lock::can_sleep())
+                        _drained.wait();
+                    else
+                        lock::pause();
+                }
+                else lock::pause();
+            }
+        }
 
         public:
         constexpr rwlock_base()
-            : counter { 0 }, readers { }, global { } { }
+            : _shards { }, _writer { false }, _wlock { }, _drained { } { }
 
         rwlock_base(const rwlock_base &) = delete;
         rwlock_base(rwlock_base &&) = delete;
@@ -34,63 +116,81 @@ export namespace lib
         rwlock_base &operator=(const rwlock_base &) = delete;
         rwlock_base &operator=(rwlock_base &&) = delete;
 
-        // TODO: broken. fix and improve it
-
         void read_lock()
         {
-            readers.lock();
-            if (++counter == 1)
-                global.lock();
-            readers.unlock();
+            enter();
+
+            auto &shard = local();
+            shard.count.fetch_add(1, std::memory_order_seq_cst);
+            if (!_writer.load(std::memory_order_seq_cst))
+                return;
+
+            // back off and wait behind the writer
+            shard.count.fetch_sub(1, std::memory_order_seq_cst);
+            reader_left();
+            _wlock.lock();
+            local().count.fetch_add(1, std::memory_order_seq_cst);
+            _wlock.unlock();
         }
 
         void write_lock()
         {
-            global.lock();
+            enter();
+            _wlock.lock();
+            _writer.store(true, std::memory_order_seq_cst);
+            wait_for_readers(0);
         }
 
         void read_unlock()
         {
             bug_on(!is_read_locked());
-
-            readers.lock();
-            if (--counter == 0)
-                global.unlock();
-            readers.unlock();
+            local().count.fetch_sub(1, std::memory_order_seq_cst);
+            reader_left();
+            leave();
         }
 
         void write_unlock()
         {
             bug_on(!is_write_locked());
-            global.unlock();
+            _writer.store(false, std::memory_order_release);
+            _wlock.unlock();
+            leave();
         }
 
-        bool is_read_locked()
+        bool is_read_locked() const
         {
-            return global.is_locked() && counter > 0;
+            return readers() > 0;
         }
 
-        bool is_write_locked()
+        bool is_write_locked() const
         {
-            return global.is_locked() && counter == 0;
+            return _writer.load(std::memory_order_relaxed);
         }
 
-        bool is_locked()
+        bool is_locked() const
         {
-            return global.is_locked();
+            return is_read_locked() || is_write_locked();
         }
 
+        // returns false if the read lock had to be dropped on the way
         bool upgrade()
         {
             bug_on(!is_read_locked());
 
-            readers.lock();
-            bool is_last = (--counter == 0);
-            readers.unlock();
-            if (!is_last)
-                global.lock();
-
-            return true;
+            if (_wlock.try_lock())
+            {
+                _writer.store(true, std::memory_order_seq_cst);
+                local().count.fetch_sub(1, std::memory_order_relaxed);
+                wait_for_readers(0);
+                return true;
+            }
+
+            local().count.fetch_sub(1, std::memory_order_seq_cst);
+            reader_left();
+            _wlock.lock();
+            _writer.store(true, std::memory_order_seq_cst);
+            wait_for_readers(0);
+            return false;
         }
     };
 
@@ -98,4 +198,4 @@ export namespace lib
     using rwspinlock_irq = rwlock_base<lock_type::irq>;
     using rwspinlock_preempt = rwlock_base<lock_type::preempt>;
     using rwmutex = rwlock_base<lock_type::block>;
-} // export namespace lib
\ No newline at end of file
+} // export namespace lib
@@ -28,7 +28,9 @@ export namespace lib
         semaphore &operator=(semaphore &&) = delete;
 
         void wait();
+        // false if it timed out
         bool wait_for(std::size_t ms);
+        bool wait_for_ns(std::size_t ns);
         void signal(bool drop = false);
     };
 } // export namespace lib
\ No newline at end of file
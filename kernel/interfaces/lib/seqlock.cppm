@@ -0,0 +1,90 @@
+// Copyright (C) 2024-2025  ilobilo
+
+export module lib:seqlock;
+
+import :spinlock;
+import cppstd;
+
+export namespace lib
+{
+    // readers never block the writer, they retry if a write happened while
+    // they were reading. the protected data must be safe to read torn
+    class seqcount
+    {
+        private:
+        std::atomic<std::uint32_t> _seq;
+
+        public:
+        constexpr seqcount() : _seq { 0 } { }
+
+        seqcount(const seqcount &) = delete;
+        seqcount &operator=(const seqcount &) = delete;
+
+        std::uint32_t read_begin() const
+        {
+            std::uint32_t seq;
+            while ((seq = _seq.load(std::memory_order_acquire)) & 1)
+                lock::pause();
+            return seq;
+        }
+
+        bool read_retry(std::uint32_t seq) const
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return _seq.load(std::memory_order_relaxed) != seq;
+        }
+
+        void write_begin()
+        {
+            _seq.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        void write_end()
+        {
+            _seq.fetch_add(1, std::memory_order_release);
+        }
+    };
+
+    // seqcount with a lock that serialises writers
+    template<typename Lock>
+    class seqlock_base
+    {
+        private:
+        seqcount _count;
+        Lock _lock;
+
+        public:
+        constexpr seqlock_base() : _count { }, _lock { } { }
+
+        std::uint32_t read_begin() const { return _count.read_begin(); }
+        bool read_retry(std::uint32_t seq) const { return _count.read_retry(seq); }
+
+        template<typename Func>
+        auto read(Func &&func) const
+        {
+            while (true)
+            {
+                const auto seq = read_begin();
+                auto ret = func();
+                if (!read_retry(seq))
+                    return ret;
+            }
+        }
+
+        void write_lock()
+        {
+            _lock.lock();
+            _count.write_begin();
+        }
+
+        void write_unlock()
+        {
+            _count.write_end();
+            _lock.unlock();
+        }
+    };
+
+    // writers may run in interrupt context
+    using seqlock = seqlock_base<spinlock_irq>;
+} // export namespace lib
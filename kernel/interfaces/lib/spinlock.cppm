@@ -6,6 +6,17 @@ import cppstd;
 
 namespace lib::lock
 {
+    struct qnode
+    {
+        std::atomic<qnode *> next;
+        std::atomic_bool wait;
+    };
+
+    // per cpu queue nodes, one for each nesting level
+    // nullptr if none are available
+    qnode *get_qnode();
+    void put_qnode();
+
     bool acquire_irq();
     void release_irq(bool irq);
 
@@ -153,7 +164,179 @@ export namespace lib
         }
     };
 
+    // mcs style lock. waiters queue up on per cpu nodes and spin on their own
+    // cache line, only the head of the queue touches the lock word. holders
+    // can't be preempted, a waiter on the same cpu would spin forever
+    template<lock_type Type>
+    class queued_spinlock_base { };
+
+    template<>
+    class queued_spinlock_base<lock_type::none>
+    {
+        private:
+        std::atomic_bool _locked;
+        std::atomic<lock::qnode *> _tail;
+
+        bool try_acquire()
+        {
+            bool expected = false;
+            return _locked.compare_exchange_strong(
+                expected, true,
+                std::memory_order_acquire,
+                std::memory_order_relaxed
+            );
+        }
+
+        void spin_acquire()
+        {
+            while (_locked.load(std::memory_order_relaxed) || !try_acquire())
+                lock::pause();
+        }
+
+        // preemption is already disabled, so the node stays ours
+        void lock_slow()
+        {
+            const auto node = lock::get_qnode();
+            if (node == nullptr)
+            {
+                spin_acquire();
+                return;
+            }
+
+            node->next.store(nullptr, std::memory_order_relaxed);
+            node->wait.store(true, std::memory_order_relaxed);
+
+            if (const auto prev = _tail.exchange(node, std::memory_order_acq_rel))
+            {
+                prev->next.store(node, std::memory_order_release);
+                while (node->wait.load(std::memory_order_acquire))
+                    lock::pause();
+            }
+
+            spin_acquire();
+
+            // hand the head of the queue to the next waiter
+            auto expected = node;
+            if (!_tail.compare_exchange_strong(
+                expected, nullptr,
+                std::memory_order_acq_rel,
+                std::memory_order_relaxed))
+            {
+                lock::qnode *next = nullptr;
+                while ((next = node->next.load(std::memory_order_acquire)) == nullptr)
+                    lock::pause();
+                next->wait.store(false, std::memory_order_release);
+            }
+
+            lock::put_qnode();
+        }
+
+        public:
+        constexpr queued_spinlock_base()
+            : _locked { false }, _tail { nullptr } { }
+
+        queued_spinlock_base(const queued_spinlock_base &) = delete;
+        queued_spinlock_base(queued_spinlock_base &&) = delete;
+
+        queued_spinlock_base &operator=(const queued_spinlock_base &) = delete;
+        queued_spinlock_base &operator=(queued_spinlock_base &&) = delete;
+
+        void lock()
+        {
+            lock::acquire_preempt();
+            if (_tail.load(std::memory_order_relaxed) == nullptr && try_acquire())
+                return;
+            lock_slow();
+        }
+
+        bool unlock()
+        {
+            if (is_locked() == false)
+                return false;
+
+            _locked.store(false, std::memory_order_release);
+            lock::release_preempt();
+            return true;
+        }
+
+        bool is_locked() const
+        {
+            return _locked.load(std::memory_order_relaxed);
+        }
+
+        bool try_lock()
+        {
+            lock::acquire_preempt();
+
+            // don't jump the queue
+            if (_tail.load(std::memory_order_relaxed) == nullptr && try_acquire())
+                return true;
+
+            lock::release_preempt();
+            return false;
+        }
+
+        bool try_lock_until(std::uint64_t ns)
+        {
+            const auto clock = lock::clock();
+            if (clock == nullptr)
+                return try_lock();
+
+            auto target = clock() + ns;
+            while (!try_lock())
+            {
+                if (clock() >= target)
+                    return false;
+                lock::pause();
+            }
+            return true;
+        }
+    };
+
+    template<>
+    class queued_spinlock_base<lock_type::irq> : public queued_spinlock_base<lock_type::none>
+    {
+        private:
+        bool _interrupts;
+
+        public:
+        constexpr queued_spinlock_base()
+            : queued_spinlock_base<lock_type::none> { }, _interrupts { false } { }
+
+        using queued_spinlock_base<lock_type::none>::queued_spinlock_base;
+
+        void lock()
+        {
+            _interrupts = lock::acquire_irq();
+            queued_spinlock_base<lock_type::none>::lock();
+        }
+
+        bool unlock()
+        {
+            if (!queued_spinlock_base<lock_type::none>::unlock())
+                return false;
+
+            lock::release_irq(_interrupts);
+            return true;
+        }
+    };
+
+    // every queued lock already keeps preemption off while held
+    template<>
+    class queued_spinlock_base<lock_type::preempt> : public queued_spinlock_base<lock_type::none>
+    {
+        public:
+        constexpr queued_spinlock_base()
+            : queued_spinlock_base<lock_type::none> { } { }
+
+        using queued_spinlock_base<lock_type::none>::queued_spinlock_base;
+    };
+
     using spinlock = spinlock_base<lock_type::none>;
     using spinlock_irq = spinlock_base<lock_type::irq>;
     using spinlock_preempt = spinlock_base<lock_type::preempt>;
+
+    using queued_spinlock = queued_spinlock_base<lock_type::none>;
+    using queued_spinlock_irq = queued_spinlock_base<lock_type::irq>;
+    using queued_spinlock_preempt = queued_spinlock_base<lock_type::preempt>;
 } // export namespace lib
\ No newline at end of file
@@ -74,6 +74,8 @@ export
             return result;
         }
 
+        constexpr bool operator==(const timespec &other) const = default;
+
         constexpr auto operator<=>(const timespec &other) const
         {
             if (tv_sec != other.tv_sec)
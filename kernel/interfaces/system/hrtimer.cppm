@@ -0,0 +1,52 @@
+// Copyright (C) 2024-2025  ilobilo
+
+export module system.hrtimer;
+
+import lib;
+import cppstd;
+
+export namespace hrtimer
+{
+    constexpr std::size_t no_cpu = std::numeric_limits<std::size_t>::max();
+
+    struct timer
+    {
+        lib::rbtree_hook hook;
+
+        // on the main clock
+        std::uint64_t expires = 0;
+        // cpu whose queue the timer is on
+        std::atomic<std::size_t> cpu = no_cpu;
+
+        // runs from the timer interrupt with interrupts disabled, may re-arm
+        std::function<void ()> func;
+
+        timer() = default;
+        timer(std::function<void ()> func) : func { std::move(func) } { }
+
+        timer(const timer &) = delete;
+        timer &operator=(const timer &) = delete;
+
+        bool pending() const
+        {
+            return cpu.load(std::memory_order_acquire) != no_cpu;
+        }
+    };
+
+    // queues the timer on this cpu to fire once the main clock reaches
+    // expires, moving it if it is already queued. O(log n)
+    void arm(timer &timer, std::uint64_t expires);
+
+    // dequeues the timer and waits for its callback if it is running on
+    // another cpu. false if it wasn't queued
+    bool cancel(timer &timer);
+
+    // earliest expiry queued on this cpu
+    std::optional<std::uint64_t> next_expiry();
+
+    // called on each cpu before it enables interrupts
+    void init_cpu();
+
+    // runs the expired timers. called from the timer interrupt
+    void handle();
+} // export namespace hrtimer
@@ -74,4 +74,33 @@ export namespace interrupts
 
     void mask(std::size_t vector);
     void unmask(std::size_t vector);
-} // export namespace interrupts
\ No newline at end of file
+
+    enum class irq_return { none, handled, wake_thread };
+
+    // quick runs in interrupt context. if it returns wake_thread, handler runs
+    // in a kernel thread dedicated to this vector. oneshot keeps the source
+    // masked until handler is done, for level triggered sources. by default
+    // that masks the ioapic or pic line of vector. msi vectors have no line,
+    // so they have to pass a mask that does it at the device
+    bool set_threaded(
+        std::size_t cpuidx, std::size_t vector,
+        std::function<irq_return (cpu::registers *)> quick,
+        std::function<void ()> handler, bool oneshot = false,
+        std::function<void (bool masked)> mask = { }
+    );
+
+    // moves the handler of vector from one cpu to another and reroutes the
+    // line, a threaded handler's thread moves with it. msi vectors are moved
+    // by routing them again instead. also written through /proc/irq_affinity
+    bool set_affinity(std::size_t vector, std::size_t from, std::size_t to);
+
+    // times vector has fired on cpuidx
+    std::size_t count(std::size_t cpuidx, std::size_t vector);
+    constexpr std::size_t max_vectors = 256;
+} // export namespace interrupts
+
+namespace interrupts
+{
+    // arch half of set_affinity, moves the handler and the line
+    bool route(std::size_t vector, std::size_t from, std::size_t to);
+} // namespace interrupts
@@ -61,7 +61,9 @@ export namespace vmm
         addr_not_aligned,
         addr_in_use,
         not_mapped,
-        invalid_entry
+        invalid_entry,
+        addr_locked,
+        not_permitted
     };
 
     using magic_enum::bitwise_operators::operator~;
@@ -139,9 +141,47 @@ export namespace vmm
             accessor access() { return _value; }
         };
 
+        static constexpr std::size_t levels = 4;
+        static constexpr std::size_t num_entries = 512;
+
         struct [[gnu::packed]] table
         {
-            entry entries[512];
+            entry entries[num_entries];
+        };
+
+        // level 0 is the root table, level (levels - 1) holds the smallest pages
+        static constexpr std::size_t shift_for(std::size_t level) { return 12 + (levels - 1 - level) * 9; }
+        static constexpr std::size_t span_for(std::size_t level) { return 1ul << shift_for(level); }
+        static constexpr std::size_t index_for(std::size_t level, std::uintptr_t vaddr) { return (vaddr >> shift_for(level)) & (num_entries - 1); }
+
+        static constexpr std::size_t level_for(page_size psize) { return levels - 1 - std::to_underlying(psize); }
+        static constexpr page_size psize_for(std::size_t level) { return static_cast<page_size>(levels - 1 - level); }
+
+        enum class kind { hole, table, leaf };
+
+        // caches the tables of the last walked address so that walking
+        // neighbouring addresses only descends from the first level that differs
+        class walker
+        {
+            private:
+            const pagemap &_pmap;
+            table *_tables[levels];
+            std::uintptr_t _vaddr;
+            std::size_t _depth;
+
+            public:
+            walker(const pagemap &pmap)
+                : _pmap { pmap }, _tables { }, _vaddr { 0 }, _depth { 0 } { }
+
+            // descend towards `target` and return the level at which the walk stopped.
+            // this is `target` itself, a level holding a large leaf or, if not allocating, a hole
+            std::size_t seek(std::uintptr_t vaddr, std::size_t target, bool allocate);
+
+            table *table_at(std::size_t level) const { return _tables[level]; }
+            entry &pte(std::size_t level) const { return _tables[level]->entries[index_for(level, _vaddr)]; }
+
+            // replace the large leaf at `level` with a table of equivalent smaller leaves
+            void split(std::size_t level);
         };
 
         table *_table;
@@ -149,6 +189,7 @@ export namespace vmm
 
         static table *new_table();
         static void free_table(table *ptr);
+        static void free_tables(table *ptr, std::size_t level);
 
         static page_size fixpsize(page_size psize);
         static void invalidate(std::uintptr_t vaddr);
@@ -156,9 +197,23 @@ export namespace vmm
         static std::uintptr_t to_arch(pflag flags, caching cache, page_size psize);
         static auto from_arch(std::uintptr_t flags, page_size psize) -> std::pair<pflag, caching>;
 
+        // whether a non-empty entry above the last level maps memory directly
+        static bool is_large(std::uintptr_t value);
+
+        static kind classify(entry &entry, std::size_t level)
+        {
+            const auto value = entry.access().value;
+            if (value == 0)
+                return kind::hole;
+            if (level == levels - 1 || is_large(value))
+                return kind::leaf;
+            return kind::table;
+        }
+
         static auto getlvl(entry &entry, bool allocate) -> table *;
 
-        auto getpte(std::uintptr_t vaddr, page_size psize, bool allocate) -> std::expected<std::reference_wrapper<entry>, error>;
+        static std::size_t leaf_level_for(std::uintptr_t vaddr, std::uintptr_t paddr, std::size_t length, page_size min);
+        void clear_range(std::uintptr_t vaddr, std::uintptr_t end, bool dealloc);
 
         public:
         auto get_arch_table(std::uintptr_t addr = 0) const -> table *;
@@ -182,6 +237,9 @@ export namespace vmm
         std::expected<void, error> unmap(std::uintptr_t vaddr, std::size_t length, page_size psize = page_size::small);
         std::expected<void, error> unmap_dealloc(std::uintptr_t vaddr, std::size_t length, page_size psize = page_size::small);
 
+        // move the ptes of [from, from + length) to `to` without touching the pages themselves
+        std::expected<void, error> move(std::uintptr_t from, std::uintptr_t to, std::size_t length);
+
         std::expected<std::uintptr_t, error> translate(std::uintptr_t vaddr, page_size psize = page_size::small);
 
         void load() const;
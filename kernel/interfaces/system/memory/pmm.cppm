@@ -6,7 +6,7 @@ import cppstd;
 namespace pmm
 {
     export constexpr std::size_t page_size = 0x1000;
-    constexpr std::size_t max_order = 15;
+    export constexpr std::size_t max_order = 15;
 
     constexpr std::size_t page_bits = 12; // std::countr_zero(page_size)
     constexpr std::size_t paddr_bits = 48;
@@ -60,6 +60,13 @@ export namespace pmm
     void *alloc(std::size_t count = 1, bool clear = false, type tp = type::normal);
     void free(void *ptr, std::size_t count = 1);
 
+    // like alloc, but returns nullptr instead of panicking
+    [[nodiscard]]
+    void *try_alloc(std::size_t count = 1, bool clear = false, type tp = type::normal);
+
+    // turn an allocated block of `count` pages into blocks of `chunk` pages that can be freed separately
+    void split(void *ptr, std::size_t count, std::size_t chunk = 1);
+
     template<typename Type = void *>
     [[nodiscard]]
     inline Type alloc(std::size_t count = 1, bool clear = false, type tp = type::normal)
@@ -72,6 +79,18 @@ export namespace pmm
         return free(reinterpret_cast<void *>(ptr), count);
     }
 
+    template<typename Type = void *>
+    [[nodiscard]]
+    inline Type try_alloc(std::size_t count = 1, bool clear = false, type tp = type::normal)
+    {
+        return reinterpret_cast<Type>(try_alloc(count, clear, tp));
+    }
+
+    inline void split(auto ptr, std::size_t count, std::size_t chunk = 1)
+    {
+        return split(reinterpret_cast<void *>(ptr), count, chunk);
+    }
+
     void reclaim_bootloader_memory();
     void init();
 } // export namespace pmm
\ No newline at end of file
@@ -6,6 +6,11 @@ export import :pagemap;
 import cppstd;
 import lib;
 
+namespace vmm
+{
+    void init_zero_page();
+} // namespace vmm
+
 export namespace vmm
 {
     enum prot
@@ -25,7 +30,18 @@ export namespace vmm
         fixed = 0x10,
         anonymous = 0x20,
 
-        untouchable = 0x40
+        untouchable = 0x40,
+        // the object was sealed against writes when this was mapped shared,
+        // so mprotect can't make it writable
+        no_write = 0x80
+    };
+
+    // per-mapping usage hints set by madvise and mlock
+    enum hint
+    {
+        sequential = 0x01,
+        hugepage = 0x02,
+        mlocked = 0x04
     };
 
     class object
@@ -45,6 +61,25 @@ export namespace vmm
         virtual ~object() { };
 
         std::uintptr_t get_page(std::size_t idx);
+        std::uintptr_t peek_page(std::size_t idx);
+
+        bool has_pages(std::size_t idx, std::size_t count);
+        // physical address of [idx, idx + count) if it is backed by one contiguous run, otherwise 0
+        std::uintptr_t contiguous(std::size_t idx, std::size_t count);
+        // insert `count` already allocated pages starting at `paddr` unless any of them is already backed
+        bool adopt_pages(std::size_t idx, std::uintptr_t paddr, std::size_t count);
+
+        // forget pages so they are requested again on the next access
+        virtual bool discard(std::size_t idx, std::size_t count)
+        {
+            lib::unused(idx, count);
+            return false;
+        }
+
+        // pages that were never requested read back as zeroes
+        virtual bool is_zero_filled() const { return false; }
+        // back faults with large pages whenever the mapping allows it
+        virtual bool prefers_huge() const { return false; }
 
         std::size_t read(std::uint64_t offset, std::span<std::byte> buffer);
         std::size_t write(std::uint64_t offset, std::span<std::byte> buffer);
@@ -56,10 +91,18 @@ export namespace vmm
     class memobject : public object
     {
         private:
+        bool _huge;
+
         std::uintptr_t request_page(std::size_t idx) override;
         void write_back() override;
 
         public:
+        memobject(bool huge = false) : _huge { huge } { }
+
+        bool is_zero_filled() const override { return true; }
+        bool prefers_huge() const override { return _huge; }
+        bool discard(std::size_t idx, std::size_t count) override;
+
         ~memobject();
     };
 
@@ -73,6 +116,7 @@ export namespace vmm
 
         std::uint8_t prot;
         std::uint8_t flags;
+        std::uint8_t hints = 0;
 
         friend bool operator<(const mapping &lhs, const mapping &rhs)
         {
@@ -88,23 +132,56 @@ export namespace vmm
             lib::rwmutex
         > tree;
 
+        // hints given to new mappings, see mlockall(MCL_FUTURE)
+        std::uint8_t future_hints = 0;
+
         std::expected<void, error> map(
             std::uintptr_t address, std::size_t length,
             std::uint8_t prot, std::uint8_t flags,
-            std::shared_ptr<object> obj, off_t offset
+            std::shared_ptr<object> obj, off_t offset,
+            std::uint8_t hints = 0
+        );
+        // same as map(), for callers that already hold tree for writing
+        std::expected<void, error> map_locked(
+            lib::btree::multiset<mapping> &mappings,
+            std::uintptr_t address, std::size_t length,
+            std::uint8_t prot, std::uint8_t flags,
+            std::shared_ptr<object> obj, off_t offset,
+            std::uint8_t hints = 0
         );
         std::expected<void, error> unmap(std::uintptr_t address, std::size_t length);
         std::expected<void, error> unmap(std::shared_ptr<object> obj);
         std::expected<void, error> protect(std::uintptr_t address, std::size_t length,std::uint8_t prot);
 
+        std::expected<std::uintptr_t, error> remap(
+            std::uintptr_t old_address, std::size_t old_length,
+            std::size_t new_length, bool may_move, std::uintptr_t new_address = 0
+        );
+
+        std::expected<void, error> set_hints(std::uintptr_t address, std::size_t length, std::uint8_t set, std::uint8_t clear);
+        std::expected<void, error> set_hints(std::uint8_t set, std::uint8_t clear);
+
+        // release the memory backing private anonymous pages, other pages are only unmapped
+        std::expected<void, error> discard(std::uintptr_t address, std::size_t length);
+        // read ahead the pages of file backed mappings
+        std::expected<void, error> prefetch(std::uintptr_t address, std::size_t length);
+        // fault in every page of the range
+        std::expected<void, error> populate(std::uintptr_t address, std::size_t length);
+
+        bool fault(std::uintptr_t addr, bool on_write);
+
         bool is_mapped(std::uintptr_t addr, std::size_t length);
-        std::uintptr_t find_free_region(std::size_t length);
+        // lowest free range of length bytes that starts at or after above, 0 if there is none
+        std::uintptr_t find_free_region(std::size_t length, std::uintptr_t above = 0);
 
         ~vmspace() { lib::panic_if(pmap.use_count() != 1); }
     };
 
     std::size_t default_page_size();
 
+    // shared read-only page backing untouched zero-filled memory
+    std::uintptr_t zero_page();
+
     bool handle_pfault(std::uintptr_t addr, bool on_write);
 
     std::uintptr_t alloc_vspace(std::size_t pages);
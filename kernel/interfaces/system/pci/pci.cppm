@@ -3,6 +3,8 @@
 export module system.pci;
 export import :regs;
 
+import system.interrupts;
+import system.cpu;
 import lib;
 import cppstd;
 
@@ -10,6 +12,12 @@ namespace pci
 {
     template<typename Type>
     concept enum_or_int = std::is_enum_v<Type> || std::integral<Type>;
+
+    namespace arch
+    {
+        // address and data that deliver vector to cpu
+        auto msi_message(std::size_t cpu, std::size_t vector) -> std::optional<std::pair<std::uint64_t, std::uint32_t>>;
+    } // namespace arch
 } // namespace pci
 
 export namespace pci
@@ -177,6 +185,14 @@ export namespace pci
             write<lib::bits2uint_t<N>>(offset, value);
         }
 
+        std::optional<std::uint16_t> find_cap(cap id) const
+        {
+            const auto it = std::ranges::find(caps, std::to_underlying(id), &decltype(caps)::value_type::first);
+            if (it == caps.end())
+                return std::nullopt;
+            return it->second;
+        }
+
         void read_bars(std::size_t nbars);
 
         virtual std::span<bar> get_bars() = 0;
@@ -210,10 +226,54 @@ export namespace pci
             std::size_t idx;
         } irq;
 
+        struct vector
+        {
+            std::size_t cpu;
+            std::size_t vector;
+        };
+        using irq_handler = std::function<void (cpu::registers *)>;
+
+        struct {
+            std::optional<vector> route;
+        } msi;
+
+        struct {
+            std::uintptr_t table;
+            std::size_t count;
+            std::vector<std::optional<vector>> routes;
+        } msix;
+
         device(std::weak_ptr<pci::bus> bus, std::uint8_t dev, std::uint8_t func)
-            : entity { bus, dev, func } { read_bars(6); }
+            : entity { bus, dev, func }, irq { }, msi { }, msix { } { read_bars(6); }
 
         std::span<bar> get_bars() override { return bars; }
+
+        // only a single message is supported
+        auto route_msi(std::size_t cpu, irq_handler handler) -> std::optional<vector>;
+        void unroute_msi();
+
+        // number of msi-x table entries, 0 if msi-x is not supported
+        std::size_t msix_count();
+
+        // allocates a vector on cpu, points entry idx at it and unmasks it.
+        // routing an entry again moves it to the new cpu
+        auto route_msix(std::size_t idx, std::size_t cpu, irq_handler handler) -> std::optional<vector>;
+        // same, with a threaded handler, see interrupts::set_threaded. oneshot
+        // keeps the entry masked until handler is done. plain msi can't mask
+        // a single vector, so it has no threaded variant
+        auto route_msix_threaded(
+            std::size_t idx, std::size_t cpu,
+            std::function<interrupts::irq_return (cpu::registers *)> quick,
+            std::function<void ()> handler, bool oneshot = false
+        ) -> std::optional<vector>;
+        void unroute_msix(std::size_t idx);
+        void mask_msix(std::size_t idx, bool masked);
+
+        private:
+        bool setup_msix();
+        // points entry idx at vec, frees vec if that fails
+        auto program_msix(std::size_t idx, std::optional<vector> vec) -> std::optional<vector>;
+        void disable_intx();
     };
 
     void addio(std::shared_ptr<configio> io, std::uint16_t seg, std::uint16_t bus);
@@ -32,4 +32,45 @@ export namespace pci
         intline = 0x3C,
         intpin = 0x3D
     };
+
+    enum class cap : std::uint8_t
+    {
+        msi = 0x05,
+        pcie = 0x10,
+        msix = 0x11
+    };
+
+    namespace msi
+    {
+        enum class ctrl : std::uint16_t
+        {
+            enable = (1 << 0),
+            mmc_mask = (0b111 << 1),
+            mme_mask = (0b111 << 4),
+            bits64 = (1 << 7),
+            per_vector_mask = (1 << 8)
+        };
+    } // namespace msi
+
+    namespace msix
+    {
+        enum class ctrl : std::uint16_t
+        {
+            size_mask = 0x7FF,
+            function_mask = (1 << 14),
+            enable = (1 << 15)
+        };
+
+        // offsets in a table entry
+        enum class entry : std::size_t
+        {
+            addr_low = 0x00,
+            addr_high = 0x04,
+            data = 0x08,
+            ctrl = 0x0C,
+            size = 0x10
+        };
+
+        inline constexpr std::uint32_t entry_masked = (1 << 0);
+    } // namespace msix
 } // export namespace pci
\ No newline at end of file
@@ -0,0 +1,202 @@
+// Copyright (C) 2024-2025  ilobilo
+
+export module system.rcu;
+
+import lib;
+import cppstd;
+
+export namespace rcu
+{
+    // read side sections disable preemption. a cpu that context switches or
+    // goes idle can't be inside one, so that is its quiescent state
+    void read_lock();
+    void read_unlock();
+
+    struct guard
+    {
+        guard() { read_lock(); }
+        ~guard() { read_unlock(); }
+
+        guard(const guard &) = delete;
+        guard &operator=(const guard &) = delete;
+    };
+
+    // waits until every read side section that was running has finished
+    void synchronize();
+
+    struct head
+    {
+        head *next;
+        void (*func)(head *);
+    };
+
+    // runs func from the rcu thread after a grace period
+    void call(head *node, void (*func)(head *));
+
+    // called by the scheduler and the idle loop
+    void quiescent();
+
+    template<typename Type>
+    inline Type *dereference(const std::atomic<Type *> &ptr)
+    {
+        return ptr.load(std::memory_order_acquire);
+    }
+
+    template<typename Type>
+    inline void assign(std::atomic<Type *> &ptr, Type *value)
+    {
+        ptr.store(value, std::memory_order_release);
+    }
+
+    template<typename Type>
+    struct list_hook
+    {
+        std::atomic<Type *> next = nullptr;
+        // only used by writers
+        Type *prev = nullptr;
+    };
+
+    // readers walk the list under read_lock, writers serialise among
+    // themselves and free removed entries after a grace period
+    template<typename Type, list_hook<Type> Type::*Hook>
+    class list
+    {
+        private:
+        std::atomic<Type *> _head;
+
+        static list_hook<Type> &hook(Type *value) { return value->*Hook; }
+
+        public:
+        class iterator
+        {
+            private:
+            Type *_current;
+
+            public:
+            using value_type = Type;
+            using difference_type = std::ptrdiff_t;
+
+            constexpr iterator(Type *current = nullptr) : _current { current } { }
+
+            Type &operator*() const { return *_current; }
+            Type *operator->() const { return _current; }
+
+            iterator &operator++()
+            {
+                _current = dereference(hook(_current).next);
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                auto ret = *this;
+                ++*this;
+                return ret;
+            }
+
+            bool operator==(const iterator &rhs) const = default;
+        };
+
+        constexpr list() : _head { nullptr } { }
+
+        list(const list &) = delete;
+        list &operator=(const list &) = delete;
+
+        iterator begin() const { return dereference(_head); }
+        iterator end() const { return nullptr; }
+
+        bool empty() const { return dereference(_head) == nullptr; }
+
+        void push_front(Type *value)
+        {
+            auto &vhook = hook(value);
+            const auto first = _head.load(std::memory_order_relaxed);
+
+            vhook.prev = nullptr;
+            vhook.next.store(first, std::memory_order_relaxed);
+            if (first != nullptr)
+                hook(first).prev = value;
+
+            // publishes the initialised entry
+            assign(_head, value);
+        }
+
+        // the entry stays intact for readers that already reached it
+        void remove(Type *value)
+        {
+            auto &vhook = hook(value);
+            const auto next = vhook.next.load(std::memory_order_relaxed);
+
+            if (vhook.prev != nullptr)
+                assign(hook(vhook.prev).next, next);
+            else
+                assign(_head, next);
+
+            if (next != nullptr)
+                hook(next).prev = vhook.prev;
+            vhook.prev = nullptr;
+        }
+
+        template<typename Func>
+        Type *find_if(Func &&func) const
+        {
+            for (auto &entry : *this)
+            {
+                if (func(entry))
+                    return &entry;
+            }
+            return nullptr;
+        }
+    };
+
+    // fixed size chained hash table built on rcu::list
+    template<
+        typename Type, auto Key, list_hook<Type> Type::*Hook,
+        typename Lookup = std::remove_cvref_t<decltype(std::declval<Type &>().*Key)>,
+        typename Hash = std::hash<Lookup>,
+        std::size_t Buckets = 16
+    >
+    class hash
+    {
+        private:
+        std::array<list<Type, Hook>, Buckets> _buckets;
+
+        static std::size_t index_of(const Lookup &key)
+        {
+            return Hash { } (key) % Buckets;
+        }
+
+        public:
+        constexpr hash() : _buckets { } { }
+
+        hash(const hash &) = delete;
+        hash &operator=(const hash &) = delete;
+
+        void insert(Type *value)
+        {
+            _buckets[index_of(Lookup { value->*Key })].push_front(value);
+        }
+
+        void remove(Type *value)
+        {
+            _buckets[index_of(Lookup { value->*Key })].remove(value);
+        }
+
+        Type *find(const Lookup &key) const
+        {
+            return _buckets[index_of(key)].find_if([&key](const Type &entry) {
+                return Lookup { entry.*Key } == key;
+            });
+        }
+
+        template<typename Func>
+        void for_each(Func &&func) const
+        {
+            for (const auto &bucket : _buckets)
+            {
+                for (auto &entry : bucket)
+                    func(entry);
+            }
+        }
+    };
+} // export namespace rcu
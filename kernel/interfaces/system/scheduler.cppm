@@ -4,6 +4,7 @@ export module system.scheduler;
 
 import system.scheduler.base;
 import system.memory.virt;
+import system.hrtimer;
 import system.cpu.self;
 import system.cpu;
 import system.vfs;
@@ -18,8 +19,6 @@ namespace cpu
 
 namespace sched
 {
-    constexpr std::size_t timeslice = 6;
-
     using nice_t = lib::ranged<std::int8_t, -20, 19>;
     constexpr nice_t default_prio = 0;
 
@@ -42,6 +41,31 @@ namespace sched
 
 export namespace sched
 {
+    // real-time threads are picked ahead of every fair thread
+    enum class policy
+    {
+        other = 0,
+        fifo = 1,
+        rr = 2
+    };
+
+    constexpr std::size_t rt_prio_min = 1;
+    constexpr std::size_t rt_prio_max = 99;
+
+    constexpr std::size_t timeslice = 6;
+
+    constexpr std::size_t max_cpus = 256;
+    using cpumask = std::bitset<max_cpus>;
+    constexpr cpumask all_cpus = ~cpumask { };
+
+    // round robin quantum
+    constexpr std::size_t rr_timeslice = 100;
+
+    // real-time threads may only use rt_runtime ms of every rt_period ms
+    // of a cpu while fair threads are waiting on it
+    constexpr std::size_t rt_period = 1000;
+    constexpr std::size_t rt_runtime = 950;
+
     enum class status
     {
         not_ready,
@@ -77,14 +101,30 @@ export namespace sched
 
         nice_t priority;
 
+        policy policy;
+        std::size_t rt_priority;
+        std::int64_t rr_left;
+
+        // cpus this thread is allowed to run on
+        cpumask affinity;
+
+        // index of the cpu whose run queue this thread belongs to
+        std::size_t cpu;
+        bool queued;
+        bool yielded;
+
         std::uint64_t vruntime;
         std::uint64_t schedule_time;
+        // ns spent running, for CLOCK_THREAD_CPUTIME_ID
+        std::uint64_t cpu_time;
 
         lib::spinlock sleep_lock;
         bool sleep_ints;
         std::size_t wake_reason;
         std::optional<std::size_t> sleep_for;
         std::optional<std::size_t> sleep_until;
+        // wakes the thread up once sleep_until passes
+        hrtimer::timer sleep_timer;
 
 #if defined(__x86_64__)
         std::uintptr_t gs_base;
@@ -97,12 +137,23 @@ export namespace sched
 
         errnos err = no_error;
 
+        // vfs::scratch(), allocated on first use
+        std::unique_ptr<char[]> path_scratch;
+
         lib::rbtree_hook rbtree_hook;
         frg::default_list_hook<thread> list_hook;
+        frg::default_list_hook<thread> rt_hook;
 
         void update_ustack(std::uintptr_t addr);
 
+        // arch specific state allocated right after the thread object
+        std::byte *arch_state()
+        {
+            return reinterpret_cast<std::byte *>(this) + lib::align_up(sizeof(thread), 64);
+        }
+
         void prepare_sleep(std::size_t ms = 0);
+        void prepare_sleep_ns(std::size_t ns = 0);
         bool wake_up(std::size_t reason);
 
         static thread *create(process *parent, std::uintptr_t ip, bool is_user);
@@ -131,6 +182,9 @@ export namespace sched
 
         bool has_execved = false;
 
+        // posix and interval timers, owned by system.syscall.time
+        std::shared_ptr<void> timers;
+
         lib::spinlock lock;
 
         process *parent;
@@ -183,11 +237,20 @@ export namespace sched
     thread *this_thread();
 
     std::size_t sleep_for(std::size_t ms);
+    std::size_t sleep_for_ns(std::size_t ns);
     std::size_t yield();
 
-    std::size_t allocate_cpu();
+    const cpumask &online_cpus();
+    // cpus given with isolcpus= on the command line,
+    // only threads pinned to them explicitly are placed there
+    const cpumask &isolated_cpus();
+
+    std::size_t allocate_cpu(const cpumask &mask = all_cpus);
     void enqueue(thread *thread, std::size_t cpu_idx);
 
+    void set_policy(thread *thread, policy policy, std::size_t rt_priority);
+    void set_affinity(thread *thread, const cpumask &mask);
+
     thread *spawn(pid_t pid, std::uintptr_t ip, nice_t priority = default_prio);
     thread *spawn_on(std::size_t cpu, pid_t pid, std::uintptr_t ip, nice_t priority = default_prio);
 
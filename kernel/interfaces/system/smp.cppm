@@ -0,0 +1,23 @@
+// Copyright (C) 2024-2025  ilobilo
+
+export module system.smp;
+
+import system.scheduler;
+import cppstd;
+
+export namespace smp
+{
+    // runs func on cpu with interrupts disabled. with wait, returns once func
+    // has finished, otherwise as soon as the call is queued. false if the cpu
+    // can't take calls yet
+    bool call_single(std::size_t cpu, std::function<void ()> func, bool wait = true);
+
+    // same for every online cpu in mask, including this one
+    void call_many(const sched::cpumask &mask, std::function<void ()> func, bool wait = true);
+
+    // called on each cpu before it enables interrupts
+    void init_cpu();
+
+    // runs the calls queued for this cpu. called from the ipi handler
+    void handle();
+} // export namespace smp
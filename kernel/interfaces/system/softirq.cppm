@@ -0,0 +1,48 @@
+// Copyright (C) 2024-2025  ilobilo
+
+export module system.softirq;
+
+import cppstd;
+
+export namespace softirq
+{
+    enum class type : std::size_t
+    {
+        timer,
+        net_tx,
+        net_rx,
+        block,
+        tasklet,
+        max
+    };
+
+    using handler = void (*)();
+
+    void register_handler(type type, handler func);
+
+    // marks type as pending on this cpu
+    void raise(type type);
+    bool pending();
+
+    // called by the interrupt dispatcher after the handler, with interrupts
+    // disabled. runs pending softirqs with interrupts enabled, anything left
+    // over after the budget is handed to the per-cpu softirq thread
+    void irq_exit();
+
+    struct tasklet
+    {
+        tasklet *next;
+        void (*func)(std::uintptr_t);
+        std::uintptr_t data;
+
+        std::atomic_bool scheduled;
+        std::atomic_bool running;
+
+        constexpr tasklet(void (*func)(std::uintptr_t), std::uintptr_t data = 0)
+            : next { nullptr }, func { func }, data { data },
+              scheduled { false }, running { false } { }
+    };
+
+    // runs t once on this cpu. does nothing if it is already scheduled
+    void schedule(tasklet &t);
+} // export namespace softirq
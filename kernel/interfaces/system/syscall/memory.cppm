@@ -10,4 +10,11 @@ export namespace syscall::memory
     void *mmap(void *addr, std::size_t length, int prot, int flags, int fd, off_t offset);
     int munmap(void *addr, std::size_t length);
     int mprotect(void *addr, std::size_t len, int prot);
+    void *mremap(void *old_address, std::size_t old_size, std::size_t new_size, int flags, void *new_address);
+    int madvise(void *addr, std::size_t length, int advice);
+
+    int mlock(const void *addr, std::size_t len);
+    int munlock(const void *addr, std::size_t len);
+    int mlockall(int flags);
+    int munlockall();
 } // export namespace syscall::memory
\ No newline at end of file
@@ -30,6 +30,20 @@ export namespace syscall::proc
     int select(int nfds, fd_set __user *readfds, fd_set __user *writefds, fd_set __user *exceptfds, timeval __user *timeout);
     int pselect(int nfds, fd_set __user *readfds, fd_set __user *writefds, fd_set __user *exceptfds, const timespec __user *timeout, const sigset_t __user *sigmask);
 
+    int sched_yield();
+
+    struct sched_param;
+    int sched_setparam(pid_t pid, const sched_param __user *param);
+    int sched_getparam(pid_t pid, sched_param __user *param);
+    int sched_setscheduler(pid_t pid, int policy, const sched_param __user *param);
+    int sched_getscheduler(pid_t pid);
+    int sched_get_priority_max(int policy);
+    int sched_get_priority_min(int policy);
+    int sched_rr_get_interval(pid_t pid, timespec __user *tp);
+    int sched_setaffinity(pid_t pid, std::size_t cpusetsize, const unsigned long __user *mask);
+    int sched_getaffinity(pid_t pid, std::size_t cpusetsize, unsigned long __user *mask);
+    int getcpu(unsigned __user *cpu, unsigned __user *node, void __user *unused);
+
     long futex(std::uint32_t __user *uaddr, int futex_op, std::uint32_t val, const timespec __user *timeout, std::uint32_t __user *uaddr2, std::uint32_t val3);
 
     int prlimit(pid_t pid, int resource, const struct rlimit __user *new_limit, struct rlimit __user *old_limit);
@@ -1,9 +1,36 @@
 // Copyright (C) 2024-2025  ilobilo
 
 export module system.syscall.time;
+
 import lib;
+import cppstd;
 
 export namespace syscall::time
 {
     int clock_gettime(clockid_t clockid, timespec __user *tp);
+    int clock_settime(clockid_t clockid, const timespec __user *tp);
+    int clock_getres(clockid_t clockid, timespec __user *res);
+    int clock_nanosleep(clockid_t clockid, int flags, const timespec __user *req, timespec __user *rem);
+    int nanosleep(const timespec __user *req, timespec __user *rem);
+
+    struct itimerspec;
+    struct itimerval;
+    struct sigevent;
+
+    int timerfd_create(clockid_t clockid, int flags);
+    int timerfd_settime(int fd, int flags, const itimerspec __user *new_value, itimerspec __user *old_value);
+    int timerfd_gettime(int fd, itimerspec __user *curr_value);
+
+    int timer_create(clockid_t clockid, sigevent __user *sevp, int __user *timerid);
+    int timer_settime(int timerid, int flags, const itimerspec __user *new_value, itimerspec __user *old_value);
+    int timer_gettime(int timerid, itimerspec __user *curr_value);
+    int timer_getoverrun(int timerid);
+    int timer_delete(int timerid);
+
+    int getitimer(int which, itimerval __user *curr_value);
+    int setitimer(int which, const itimerval __user *new_value, itimerval __user *old_value);
+    unsigned int alarm(unsigned int seconds);
+
+    int gettimeofday(timeval __user *tv, void __user *tz);
+    time_t time(time_t __user *tloc);
 } // export namespace syscall::time
\ No newline at end of file
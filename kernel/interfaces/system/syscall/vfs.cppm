@@ -26,6 +26,7 @@ export namespace syscall::vfs
     std::ssize_t pwritev(int fd, const struct iovec __user *iov, int iovcnt, off_t offset);
 
     off_t lseek(int fd, off_t offset, int whence);
+    std::ssize_t getdents64(int fd, void __user *dirp, std::size_t count);
 
     int fstatat(int dirfd, const char __user *pathname, stat __user *statbuf, int flags);
     int stat(const char __user *pathname, struct stat __user *statbuf);
@@ -35,6 +36,9 @@ export namespace syscall::vfs
     int faccessat(int dirfd, const char __user *pathname, int mode, int flags);
     int access(const char __user *pathname, int mode);
 
+    int ftruncate(int fd, off_t length);
+    int memfd_create(const char __user *name, unsigned int flags);
+
     int ioctl(int fd, unsigned long request, void __user *argp);
     int fcntl(int fd, int cmd, std::uintptr_t arg);
 
@@ -43,4 +47,6 @@ export namespace syscall::vfs
     int dup3(int oldfd, int newfd, int flags);
 
     char *getcwd(char __user *buf, std::size_t size);
+
+    int mount(const char __user *source, const char __user *target, const char __user *fstype, unsigned long flags, const void __user *data);
 } // export namespace syscall::vfs
\ No newline at end of file
@@ -8,11 +8,17 @@ export import system.bin;
 export import system.cpu;
 export import system.cpu.self;
 export import system.dev;
+export import system.hrtimer;
 export import system.interrupts;
 export import system.memory;
 export import system.net;
 export import system.pci;
+export import system.rcu;
 export import system.scheduler;
+export import system.smp;
+export import system.softirq;
 export import system.syscall;
 export import system.time;
-export import system.vfs;
\ No newline at end of file
+export import system.vdso;
+export import system.vfs;
+export import system.workqueue;
\ No newline at end of file
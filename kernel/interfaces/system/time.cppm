@@ -26,5 +26,54 @@ export namespace time
 
     bool stall_ns(std::size_t ns);
 
-    timespec now(clockid_t clockid = 0);
-} // export namespace time
\ No newline at end of file
+    enum clock_id : clockid_t
+    {
+        realtime = 0,
+        monotonic = 1,
+        process_cputime = 2,
+        thread_cputime = 3,
+        monotonic_raw = 4,
+        realtime_coarse = 5,
+        monotonic_coarse = 6,
+        boottime = 7
+    };
+
+    // resolution of the coarse clocks
+    constexpr std::uint64_t coarse_period = 4'000'000;
+
+    // clocks kept by the timekeeper, the cputime ones are the scheduler's
+    bool is_valid(clockid_t clockid);
+
+    std::uint64_t ns(clockid_t clockid = monotonic);
+    timespec now(clockid_t clockid = realtime);
+
+    // monotonic = mono_last + (((raw - raw_last) * mult) >> 32) where raw is
+    // the main clock. also published to the vdso
+    struct state
+    {
+        std::uint64_t raw_last;
+        std::uint64_t mono_last;
+        std::uint64_t mult;
+
+        // monotonic_raw = raw + raw_offset, moved when the main clock changes
+        std::int64_t raw_offset;
+        // realtime = monotonic + realtime_offset
+        std::int64_t realtime_offset;
+        // time spent suspended, boottime = monotonic + boot_offset
+        std::uint64_t boot_offset;
+
+        std::uint64_t coarse_mono;
+    };
+    state current_state();
+
+    // steps CLOCK_REALTIME
+    void set_realtime(timespec ts);
+
+    // slews CLOCK_MONOTONIC and CLOCK_REALTIME by ppb parts per billion.
+    // CLOCK_MONOTONIC_RAW always follows the clock source
+    void adjust_frequency(std::int64_t ppb);
+    std::int64_t frequency_adjustment();
+
+    // refreshes the coarse clocks, called from the timer interrupt
+    void tick();
+} // export namespace time
@@ -0,0 +1,20 @@
+// Copyright (C) 2024-2025  ilobilo
+
+export module system.vdso;
+
+import system.memory;
+import system.time;
+import cppstd;
+
+export namespace vdso
+{
+    // maps the data pages and the image into vmspace. returns the image
+    // base for AT_SYSINFO_EHDR, 0 if there is no vdso
+    std::uintptr_t map(vmm::vmspace &vmspace);
+
+    // republishes the clock parameters, call when the clock source changes
+    void update();
+
+    // republishes the timekeeper. the caller holds the time write lock
+    void update_time(const time::state &tk);
+} // export namespace vdso
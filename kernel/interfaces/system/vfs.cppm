@@ -3,6 +3,7 @@
 export module system.vfs;
 
 import system.memory.virt;
+import system.rcu;
 import lib;
 import cppstd;
 
@@ -21,6 +22,7 @@ export namespace vfs
         not_a_block,
 
         symloop_max,
+        name_too_long,
 
         target_is_a_dir,
         target_is_busy,
@@ -114,6 +116,17 @@ export namespace vfs
         at_empty_path = 0x1000
     };
 
+    enum seals : int
+    {
+        f_seal_seal = 0x01,
+        f_seal_shrink = 0x02,
+        f_seal_grow = 0x04,
+        f_seal_write = 0x08,
+        f_seal_future_write = 0x10,
+
+        all_seals = f_seal_seal | f_seal_shrink | f_seal_grow | f_seal_write | f_seal_future_write
+    };
+
     enum accchecks : int
     {
         f_ok = 0,
@@ -122,11 +135,97 @@ export namespace vfs
         r_ok = 4
     };
 
+    enum pollevents : int
+    {
+        pollin = 0x001,
+        pollpri = 0x002,
+        pollout = 0x004,
+        pollerr = 0x008,
+        pollhup = 0x010,
+        pollnval = 0x020
+    };
+
+    // a select() call sleeping until one of its files may have become ready
+    struct poll_waiter
+    {
+        lib::semaphore wake;
+    };
+
+    // select() calls sleeping on a file. whatever changes what ops::poll()
+    // returns for the file calls notify()
+    class poll_queue
+    {
+        private:
+        lib::spinlock _lock;
+        std::list<poll_waiter *> _waiters;
+        std::atomic_size_t _count = 0;
+
+        public:
+        void add(poll_waiter *waiter)
+        {
+            const std::unique_lock _ { _lock };
+            _waiters.push_back(waiter);
+            _count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void remove(poll_waiter *waiter)
+        {
+            const std::unique_lock _ { _lock };
+            _count.fetch_sub(std::erase(_waiters, waiter), std::memory_order_relaxed);
+        }
+
+        // lockless hint for interrupt handlers deciding whether to defer a notify()
+        bool empty() const
+        {
+            return _count.load(std::memory_order_relaxed) == 0;
+        }
+
+        void notify()
+        {
+            const std::unique_lock _ { _lock };
+            for (const auto waiter : _waiters)
+                waiter->wake.signal();
+        }
+    };
+
+    enum mountflags : int
+    {
+        ms_rdonly = 0x0000001,
+        ms_nosuid = 0x0000002,
+        ms_nodev = 0x0000004,
+        ms_noexec = 0x0000008,
+        ms_noatime = 0x0000400,
+        ms_nodiratime = 0x0000800,
+        // atime only moves if it is older than mtime or ctime, or a day old
+        ms_relatime = 0x0200000,
+        ms_strictatime = 0x1000000,
+        // timestamps stay in memory until something else writes the inode back
+        ms_lazytime = 0x2000000
+    };
+
     // stat and s_* bits are defined in lib/types.cppm
 
     template<typename Type>
     using expect = std::expected<Type, error>;
 
+    // d_type in dirents
+    inline constexpr std::uint8_t dirent_type(mode_t mode)
+    {
+        return static_cast<std::uint8_t>(stat::type(mode) >> 12);
+    }
+
+    // the cursor readdir continues from. 0 and 1 are . and .., the rest are
+    // up to the filesystem but must stay valid while entries come and go
+    struct dir_context
+    {
+        std::uint64_t pos = 0;
+
+        // false if the entry didn't fit. pos is only moved past it on true
+        virtual bool emit(std::string_view name, ino_t ino, std::uint8_t type, std::uint64_t next) = 0;
+
+        virtual ~dir_context() = default;
+    };
+
     struct file;
     struct ops
     {
@@ -154,6 +253,32 @@ export namespace vfs
 
         virtual std::shared_ptr<vmm::object> map(std::shared_ptr<file> self, bool priv) = 0;
 
+        // pollevents that wouldn't block right now
+        virtual int poll(std::shared_ptr<file> self)
+        {
+            lib::unused(self);
+            return pollin | pollout;
+        }
+
+        virtual int add_seals(std::shared_ptr<file> self, int seals)
+        {
+            lib::unused(self, seals);
+            return (errno = EINVAL, -1);
+        }
+
+        virtual int get_seals(std::shared_ptr<file> self)
+        {
+            lib::unused(self);
+            return (errno = EINVAL, -1);
+        }
+
+        // emits entries from ctx.pos until there is no more room
+        virtual int readdir(std::shared_ptr<file> self, dir_context &ctx)
+        {
+            lib::unused(self, ctx);
+            return (errno = ENOTDIR, -1);
+        }
+
         virtual bool sync() = 0;
 
         virtual ~ops() = default;
@@ -204,6 +329,8 @@ export namespace vfs
         lib::locked_ptr<filesystem::instance, lib::mutex> fs;
         std::shared_ptr<dentry> root;
         std::optional<path> mounted_on;
+        // mountflags, relatime unless noatime or strictatime was asked for
+        int flags = 0;
     };
 
     struct inode
@@ -234,6 +361,33 @@ export namespace vfs
             >, lib::rwmutex
         > children;
 
+        // lock free lookups into children. updated under its write lock
+        rcu::list_hook<dentry> child_hook;
+        rcu::hash<
+            dentry, &dentry::name, &dentry::child_hook,
+            std::string_view
+        > child_index;
+
+        // children in the order they were added, readdir cursors are cookies.
+        // also under children's lock
+        struct by_cookie
+        {
+            bool operator()(const dentry &lhs, const dentry &rhs) const
+            {
+                return lhs.cookie < rhs.cookie;
+            }
+        };
+        lib::rbtree_hook cursor_hook;
+        std::uint64_t cookie = 0;
+        lib::rbtree<dentry, &dentry::cursor_hook, by_cookie> cursors;
+        std::uint64_t next_cookie = 2;
+
+        // keeps a removed dentry alive until lookups can no longer find it
+        struct retired_ref : rcu::head
+        {
+            std::shared_ptr<dentry> self;
+        } retired;
+
         std::list<std::weak_ptr<mount>> child_mounts;
     };
 
@@ -252,6 +406,9 @@ export namespace vfs
         std::size_t offset;
         int flags;
 
+        // declared before private_data so it outlives whatever notifies it
+        poll_queue pollers;
+
         std::shared_ptr<void> private_data;
 
         bool open()
@@ -307,6 +464,31 @@ export namespace vfs
             return get_ops()->map(shared_from_this(), priv);
         }
 
+        int poll()
+        {
+            return get_ops()->poll(shared_from_this());
+        }
+
+        int add_seals(int seals)
+        {
+            return get_ops()->add_seals(shared_from_this(), seals);
+        }
+
+        int get_seals()
+        {
+            return get_ops()->get_seals(shared_from_this());
+        }
+
+        // offset is the cursor
+        int readdir(dir_context &ctx)
+        {
+            std::unique_lock _ { lock };
+            ctx.pos = offset;
+            const auto ret = get_ops()->readdir(shared_from_this(), ctx);
+            offset = ctx.pos;
+            return ret;
+        }
+
         static std::shared_ptr<file> create(const vfs::path &path, std::size_t offset, int flags)
         {
             auto file = std::make_shared<vfs::file>();
@@ -360,10 +542,15 @@ export namespace vfs
     bool register_fs(std::unique_ptr<filesystem> fs);
     auto find_fs(std::string_view name) -> expect<std::reference_wrapper<std::unique_ptr<filesystem>>>;
 
-    std::string pathname_from(path path);
+    // path_max bytes private to this thread. path walks splice symlink
+    // targets in here, callers may borrow it when no vfs call is in between
+    std::span<char> scratch();
+
+    // formats path into the end of buffer
+    auto pathname_from(const path &path, std::span<char> buffer) -> expect<std::string_view>;
 
-    auto path_for(lib::path _path) -> expect<path>;
-    auto resolve(std::optional<path> parent, lib::path path) -> expect<resolve_res>;
+    auto path_for(lib::path_view _path) -> expect<path>;
+    auto resolve(std::optional<path> parent, lib::path_view path) -> expect<resolve_res>;
     auto reduce(path parent, path src, std::size_t symlink_depth = symloop_max) -> expect<path>;
 
     auto mount(lib::path source, lib::path target, std::string_view fstype, int flags) -> expect<void>;
@@ -376,8 +563,16 @@ export namespace vfs
 
     bool check_access(uid_t uid, gid_t gid, const stat &stat, int mode);
 
+    // updates the stat::time timestamps in which, following the atime policy
+    // of the mount and o_noatime on file
+    void touch(const path &path, std::uint8_t which, int flags = 0);
+    void touch(const file &file, std::uint8_t which);
+
     auto stat(std::optional<path> parent, lib::path path) -> expect<stat>;
     bool populate(path parent, std::string_view name = "");
 
+    // readdir for filesystems that keep everything in the dentry cache
+    int dcache_readdir(const path &dir, dir_context &ctx);
+
     lib::initgraph::stage *root_mounted_stage();
 } // export namespace vfs
\ No newline at end of file
@@ -0,0 +1,23 @@
+// Copyright (C) 2024-2025  ilobilo
+
+export module system.workqueue;
+
+import cppstd;
+
+export namespace workqueue
+{
+    // deferred work that runs in a per-cpu kernel thread, so it may sleep
+    struct work
+    {
+        work *next;
+        void (*func)(work *);
+        std::atomic_bool pending;
+
+        constexpr work(void (*func)(work *))
+            : next { nullptr }, func { func }, pending { false } { }
+    };
+
+    // false if w is already queued. safe from interrupt context
+    bool queue(work &w);
+    bool queue_on(std::size_t cpu, work &w);
+} // export namespace workqueue
@@ -78,5 +78,9 @@ namespace arch
         {
             cpu::write_el1_base(addr);
         }
+        void booting(std::size_t idx)
+        {
+            lib::unused(idx);
+        }
     } // namespace core
 } // namespace arch
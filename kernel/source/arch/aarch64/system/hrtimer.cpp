@@ -0,0 +1,19 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module system.hrtimer;
+
+import lib;
+import cppstd;
+
+namespace hrtimer::arch
+{
+    bool init()
+    {
+        return false;
+    }
+
+    void program(std::uint64_t expires)
+    {
+        lib::unused(expires);
+    }
+} // namespace hrtimer::arch
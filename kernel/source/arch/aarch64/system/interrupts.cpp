@@ -11,4 +11,6 @@ namespace interrupts
     std::optional<std::reference_wrapper<handler>> get(std::size_t cpuidx, std::size_t vector) { lib::unused(cpuidx, vector); return std::nullopt; }
     void mask(std::size_t vector) { lib::unused(vector); }
     void unmask(std::size_t vector) { lib::unused(vector); }
+    bool route(std::size_t vector, std::size_t from, std::size_t to) { lib::unused(vector, from, to); return false; }
+    std::size_t count(std::size_t cpuidx, std::size_t vector) { lib::unused(cpuidx, vector); return 0; }
 } // export namespace interrupts
\ No newline at end of file
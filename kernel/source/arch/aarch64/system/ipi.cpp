@@ -0,0 +1,19 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module system.smp;
+
+import lib;
+import cppstd;
+
+namespace smp::arch
+{
+    bool init()
+    {
+        return false;
+    }
+
+    void send(std::size_t cpu)
+    {
+        lib::unused(cpu);
+    }
+} // namespace smp::arch
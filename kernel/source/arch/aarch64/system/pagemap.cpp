@@ -77,6 +77,11 @@ namespace vmm
         cpu::invlpg(vaddr);
     }
 
+    bool pagemap::is_large(std::uintptr_t value)
+    {
+        return (value & arch::flag::table) == 0;
+    }
+
     std::uintptr_t pagemap::to_arch(pflag flags, caching cache, page_size psize)
     {
         lib::bug_on(!magic_enum::enum_contains(cache));
@@ -11,5 +11,12 @@ namespace pci
     {
         lib::initgraph::stage *ios_discovered_stage();
         lib::initgraph::stage *rbs_discovered_stage();
+
+        // TODO: gicv3 its
+        auto msi_message(std::size_t cpu, std::size_t vector) -> std::optional<std::pair<std::uint64_t, std::uint32_t>>
+        {
+            lib::unused(cpu, vector);
+            return std::nullopt;
+        }
     } // namespace arch
 } // namespace pci
\ No newline at end of file
@@ -21,6 +21,23 @@ namespace sched::arch
         lib::unused(ms);
     }
 
+    void kick(std::size_t cpu_idx)
+    {
+        lib::unused(cpu_idx);
+    }
+
+    bool can_monitor()
+    {
+        return false;
+    }
+
+    void idle_wait(const std::atomic_bool &flag, bool deep)
+    {
+        lib::unused(deep);
+        if (!flag.load())
+            asm volatile ("wfi" ::: "memory");
+    }
+
     void finalise(process *proc, thread *thread, std::uintptr_t ip)
     {
         lib::unused(proc, thread, ip);
@@ -45,4 +62,9 @@ namespace sched::arch
     {
         lib::unused(thread, addr);
     }
+
+    std::size_t state_size()
+    {
+        return 0;
+    }
 } // namespace sched::arch
\ No newline at end of file
@@ -0,0 +1,29 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module;
+
+#include <vdso/data.h>
+
+module system.vdso;
+
+import lib;
+import cppstd;
+
+namespace vdso::arch
+{
+    std::span<const std::byte> image()
+    {
+        return { };
+    }
+
+    void update(vdso_data &data)
+    {
+        data.mode = vdso_mode_none;
+    }
+
+    std::uintptr_t pvclock_page(std::size_t cpuidx)
+    {
+        lib::unused(cpuidx);
+        return 0;
+    }
+} // namespace vdso::arch
@@ -138,6 +138,11 @@ namespace arch
             sched::start();
         }
 
+        void booting(std::size_t idx)
+        {
+            x86_64::timers::tsc::sync_source(idx);
+        }
+
         void bsp(std::uintptr_t addr)
         {
             auto ptr = reinterpret_cast<cpu::processor *>(addr);
@@ -40,6 +40,9 @@ namespace x86_64::timers::kvm
     cpu_local<void *> clockptr;
     cpu_local_init(clockptr, nullptr);
 
+    cpu_local<std::uintptr_t> clockphys;
+    cpu_local_init(clockphys, 0);
+
     bool supported()
     {
         static const auto cached = [] -> bool
@@ -86,6 +89,13 @@ namespace x86_64::timers::kvm
         return freq;
     }
 
+    std::uintptr_t pvclock_page(std::size_t cpuidx)
+    {
+        return clockphys.get(cpu::local::nth_base(cpuidx));
+    }
+
+    std::int64_t clock_offset() { return offset; }
+
     time::clock clock { "kvm", 100, time_ns };
 
     void init_cpu()
@@ -105,6 +115,7 @@ namespace x86_64::timers::kvm
 
         const auto obj = std::construct_at<kvmclock_info>(reinterpret_cast<kvmclock_info *>(vaddr));
         clockptr = reinterpret_cast<void *>(obj);
+        clockphys = paddr;
 
         cpu::msr::write(0x4B564D01, paddr | 1);
 
@@ -2,10 +2,133 @@
 
 module x86_64.drivers.timers.rtc;
 
-import arch.drivers.timers;
+import x86_64.drivers.timers.hpet;
+import x86_64.drivers.timers.kvm;
+import x86_64.drivers.timers.pit;
+import x86_64.drivers.timers.tsc;
+import system.time;
+import arch;
+import lib;
 import cppstd;
 
 namespace x86_64::timers::rtc
 {
-    // TODO
-} // namespace x86_64::timers::rtc
\ No newline at end of file
+    namespace
+    {
+        constexpr std::uint16_t cmos_index = 0x70;
+        constexpr std::uint16_t cmos_data = 0x71;
+
+        enum reg : std::uint8_t
+        {
+            seconds = 0x00,
+            minutes = 0x02,
+            hours = 0x04,
+            day = 0x07,
+            month = 0x08,
+            year = 0x09,
+            status_a = 0x0A,
+            status_b = 0x0B
+        };
+
+        std::uint8_t read(reg idx)
+        {
+            // keep nmis disabled
+            lib::io::out<8>(cmos_index, static_cast<std::uint8_t>(0x80 | idx));
+            return lib::io::in<8>(cmos_data);
+        }
+
+        bool updating()
+        {
+            return read(status_a) & (1 << 7);
+        }
+
+        struct datetime
+        {
+            std::uint8_t seconds, minutes, hours;
+            std::uint8_t day, month, year;
+
+            bool operator==(const datetime &) const = default;
+        };
+
+        datetime read_raw()
+        {
+            while (updating())
+                ::arch::pause();
+
+            return datetime {
+                read(seconds), read(minutes), read(hours),
+                read(day), read(month), read(year)
+            };
+        }
+
+        std::uint8_t from_bcd(std::uint8_t value)
+        {
+            return (value & 0x0F) + ((value >> 4) * 10);
+        }
+    } // namespace
+
+    std::uint64_t time()
+    {
+        // read until two reads agree, so an update can't tear it
+        auto dt = read_raw();
+        for (auto last = dt; (dt = read_raw()) != last; last = dt) { }
+
+        const auto status = read(status_b);
+        const bool binary = status & (1 << 2);
+        const bool hour24 = status & (1 << 1);
+
+        // the pm bit is kept out of the bcd conversion
+        const bool pm = dt.hours & 0x80;
+        dt.hours &= 0x7F;
+
+        if (!binary)
+        {
+            dt.seconds = from_bcd(dt.seconds);
+            dt.minutes = from_bcd(dt.minutes);
+            dt.hours = from_bcd(dt.hours);
+            dt.day = from_bcd(dt.day);
+            dt.month = from_bcd(dt.month);
+            dt.year = from_bcd(dt.year);
+        }
+
+        if (!hour24)
+        {
+            // 12 am is 0, 12 pm is 12
+            dt.hours %= 12;
+            if (pm)
+                dt.hours += 12;
+        }
+
+        // the century register isn't standard
+        return lib::timestamp(2000 + dt.year, dt.month, dt.day, dt.hours, dt.minutes, dt.seconds);
+    }
+
+    lib::initgraph::stage *initialised_stage()
+    {
+        static lib::initgraph::stage stage
+        {
+            "timers.arch.rtc.initialised",
+            lib::initgraph::presched_init_engine
+        };
+        return &stage;
+    }
+
+    lib::initgraph::task rtc_task
+    {
+        "timers.arch.rtc.initialise",
+        lib::initgraph::presched_init_engine,
+        // realtime is kept relative to the main clock, so pick that first
+        lib::initgraph::require {
+            pit::initialised_stage(),
+            hpet::initialised_stage(),
+            kvm::initialised_stage(),
+            tsc::initialised_stage()
+        },
+        lib::initgraph::entail { initialised_stage() },
+        [] {
+            const auto secs = time();
+            log::info("rtc: current time is {}", secs);
+            ::time::set_realtime(timespec { static_cast<time_t>(secs), 0 });
+        }
+    };
+} // namespace x86_64::timers::rtc
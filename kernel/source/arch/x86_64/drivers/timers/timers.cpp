@@ -65,7 +65,7 @@ namespace timers::arch
         "timers.arch.initialise",
         lib::initgraph::presched_init_engine,
         lib::initgraph::require {
-            // rtc::initialised_stage(),
+            rtc::initialised_stage(),
             pit::initialised_stage(),
             hpet::initialised_stage(),
             kvm::initialised_stage(),
@@ -7,6 +7,7 @@ import drivers.timers;
 import system.cpu.self;
 import system.cpu;
 import system.time;
+import arch;
 
 import lib;
 import cppstd;
@@ -21,6 +22,128 @@ namespace x86_64::timers::tsc
         cpu_local_init(offset, 0);
 
         bool is_calibrated = false;
+
+        // some cpu's tsc couldn't be brought in line with the bsp's
+        bool unsynced = false;
+        std::uint64_t bsp_adjust = 0;
+
+        constexpr std::uint32_t tsc_adjust_msr = 0x3B;
+
+        bool adjust_supported()
+        {
+            static const auto cached = []
+            {
+                cpu::id_res res;
+                return cpu::id(7, 0, res) && (res.b & (1 << 1));
+            } ();
+            return cached;
+        }
+
+        // the bsp and a booting cpu take turns reading the tsc under a lock.
+        // a value lower than the one the other cpu read before it is a warp
+        namespace sync
+        {
+            constexpr std::size_t max_runs = 3;
+            constexpr std::size_t run_ns = 2'000'000;
+            constexpr std::size_t arrive_timeout_ns = 1'000'000'000;
+
+            // only ever grows, each barrier is the next multiple of two
+            std::atomic_size_t arrived = 0;
+
+            lib::spinlock lock;
+            std::uint64_t last;
+            bool last_target;
+
+            // biggest warps seen, with the target's tsc behind or ahead
+            std::uint64_t behind;
+            std::uint64_t ahead;
+
+            void barrier(bool timeout = false)
+            {
+                const auto goal = (arrived.fetch_add(1, std::memory_order_acq_rel) / 2 + 1) * 2;
+                const auto start = rdtsc();
+                while (arrived.load(std::memory_order_acquire) < goal)
+                {
+                    if (timeout && freq.nanos(rdtsc() - start) > arrive_timeout_ns)
+                        lib::panic("tsc: a cpu did not show up for the sync check");
+                    ::arch::pause();
+                }
+            }
+
+            void check(bool is_target)
+            {
+                const auto end = rdtsc() + freq.ticks(run_ns);
+                while (true)
+                {
+                    lock.lock();
+                    const auto prev = last;
+                    const bool prev_target = last_target;
+                    const auto now = rdtsc();
+                    last = now;
+                    last_target = is_target;
+                    lock.unlock();
+
+                    if (prev != 0 && now < prev && prev_target != is_target)
+                    {
+                        auto &warp = is_target ? behind : ahead;
+                        lock.lock();
+                        warp = std::max(warp, prev - now);
+                        lock.unlock();
+                    }
+
+                    if (now >= end)
+                        break;
+                }
+            }
+
+            // true if another run is needed, the target has moved its tsc
+            bool evaluate(bool is_target, std::size_t run)
+            {
+                if (behind == 0 && ahead == 0)
+                    return false;
+                if (!adjust_supported() || run + 1 == max_runs)
+                    return false;
+
+                if (is_target)
+                {
+                    const auto value = cpu::msr::read(tsc_adjust_msr);
+                    const auto delta = behind != 0 ? behind : -ahead;
+                    cpu::msr::write(tsc_adjust_msr, value + delta);
+                }
+                return true;
+            }
+        } // namespace sync
+
+        // runs on a booting cpu alongside sync_source() on the bsp,
+        // false if its tsc is still off
+        bool sync_target()
+        {
+            const auto idx = cpu::self()->idx;
+
+            // firmware sometimes leaves these different between cpus
+            if (adjust_supported())
+            {
+                if (const auto value = cpu::msr::read(tsc_adjust_msr); value != bsp_adjust)
+                {
+                    log::warn("tsc: cpu {} has tsc adjust {}, using the bsp's {}", idx, value, bsp_adjust);
+                    cpu::msr::write(tsc_adjust_msr, bsp_adjust);
+                }
+            }
+
+            for (std::size_t run = 0; ; run++)
+            {
+                sync::barrier();
+                sync::check(true);
+                sync::barrier();
+
+                const bool again = sync::evaluate(true, run);
+                const bool warped = sync::behind != 0 || sync::ahead != 0;
+                sync::barrier();
+
+                if (!again)
+                    return !warped;
+            }
+        }
     } // namespace
 
     bool supported()
@@ -35,6 +158,16 @@ namespace x86_64::timers::tsc
         return cached;
     }
 
+    bool aux_supported()
+    {
+        static const auto cached = []
+        {
+            cpu::id_res res;
+            return cpu::id(0x80000001, 0, res) && (res.d & (1 << 27));
+        } ();
+        return cached;
+    }
+
     lib::freqfrac frequency() { return freq; }
 
     extern "C++" std::uint64_t rdtsc()
@@ -52,8 +185,54 @@ namespace x86_64::timers::tsc
         return freq.nanos(rdtsc()) - offset.get();
     }
 
+    std::int64_t offset_of(std::size_t cpuidx)
+    {
+        return offset.get(cpu::local::nth_base(cpuidx));
+    }
+
+    void sync_source(std::size_t cpuidx)
+    {
+        if (!is_calibrated)
+            return;
+
+        for (std::size_t run = 0; ; run++)
+        {
+            sync::last = 0;
+            sync::last_target = false;
+            sync::behind = sync::ahead = 0;
+
+            sync::barrier(run == 0);
+            sync::check(false);
+            sync::barrier();
+
+            const bool again = sync::evaluate(false, run);
+            const auto behind = sync::behind;
+            const auto ahead = sync::ahead;
+            sync::barrier();
+
+            if (again)
+                continue;
+
+            if (behind != 0 || ahead != 0)
+            {
+                unsynced = true;
+                log::warn(
+                    "tsc: cpu {} is out of sync, {} cycles {} the bsp",
+                    cpuidx, behind != 0 ? behind : ahead, behind != 0 ? "behind" : "ahead of"
+                );
+            }
+            else if (run != 0)
+                log::info("tsc: cpu {} synchronised after {} adjustments", cpuidx, run);
+            return;
+        }
+    }
+
     void init_cpu()
     {
+        // lets rdtscp and the vdso tell which cpu they ran on
+        if (aux_supported())
+            cpu::msr::write(0xC0000103, cpu::self()->idx);
+
         if (!supported())
             return;
 
@@ -94,10 +273,17 @@ namespace x86_64::timers::tsc
             else log::debug("tsc: not calibrated");
         }
 
+        const auto is_bsp = (cpu::self()->idx == cpu::bsp_idx());
+        if (is_bsp && adjust_supported())
+            bsp_adjust = cpu::msr::read(tsc_adjust_msr);
+
         if (is_calibrated)
         {
             auto &ref = offset.get();
-            if (const auto clock = time::main_clock())
+            // in sync with the bsp, so its offset is exact for us too
+            if (!is_bsp && sync_target())
+                ref = offset_of(cpu::bsp_idx());
+            else if (const auto clock = time::main_clock())
                 ref += time_ns() - clock->ns();
             else
                 ref = time_ns();
@@ -128,7 +314,16 @@ namespace x86_64::timers::tsc
     time::clock clock { "tsc", 75, time_ns };
     void finalise()
     {
-        if (is_calibrated)
-            time::register_clock(clock);
+        if (!is_calibrated)
+            return;
+
+        // time could go backwards when a thread migrates, only use it
+        // if nothing better is there
+        if (unsynced)
+        {
+            log::warn("tsc: not synchronised between cpus, demoting it");
+            clock.priority = 10;
+        }
+        time::register_clock(clock);
     }
 } // namespace x86_64::timers::tsc
\ No newline at end of file
@@ -0,0 +1,31 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module system.hrtimer;
+
+import x86_64.system.lapic;
+import system.interrupts;
+import system.cpu.self;
+import system.time;
+import lib;
+import cppstd;
+
+namespace hrtimer::arch
+{
+    static constexpr std::size_t timer_vector = 0xFC;
+
+    bool init()
+    {
+        auto [handler, vector] = interrupts::allocate(cpu::self()->idx, timer_vector).value();
+        lib::bug_on(vector != timer_vector);
+        handler.set([](cpu::registers *) { handle(); });
+        return true;
+    }
+
+    // the lapic timer counts on the tsc in deadline mode, so the main
+    // clock is only used to find out how far away expires is
+    void program(std::uint64_t expires)
+    {
+        const auto now = time::main_clock()->ns();
+        x86_64::apic::arm(expires > now ? expires - now : 0, timer_vector);
+    }
+} // namespace hrtimer::arch
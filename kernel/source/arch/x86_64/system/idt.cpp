@@ -13,6 +13,7 @@ import x86_64.system.pic;
 import system.memory.virt;
 import system.interrupts;
 import system.scheduler;
+import system.softirq;
 import system.cpu.self;
 import system.cpu;
 import frigg;
@@ -64,8 +65,18 @@ namespace x86_64::idt
     > irq_handlers;
     cpu_local_init(irq_handlers);
 
+    // only written by the owning cpu
+    cpu_local<std::array<std::atomic_size_t, num_ints>> irq_counts;
+    cpu_local_init(irq_counts);
+
     std::array<entry, num_ints> &table() { return idt; }
 
+    std::size_t count_at(std::size_t cpuidx, std::uint8_t num)
+    {
+        const auto &counts = irq_counts.get(cpu::local::nth_base(cpuidx));
+        return counts[num].load(std::memory_order_relaxed);
+    }
+
     [[nodiscard]]
     auto handler_at(std::size_t cpuidx, std::uint8_t num) -> std::optional<std::reference_wrapper<interrupts::handler>>
     {
@@ -96,6 +107,9 @@ namespace x86_64::idt
 
         if (vector >= irq(0) && vector <= 0xFF)
         {
+            auto &count = irq_counts.get()[vector];
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
             const auto idx = vector - irq(0);
             if (irq_handlers->size() > idx)
             {
@@ -140,6 +154,10 @@ namespace x86_64::idt
 
         end:
         self->in_interrupt.store(old, std::memory_order_release);
+
+        // bottom halves run with interrupts enabled, so never on an ist stack
+        if (!old && idt[vector].ist == 0)
+            softirq::irq_exit();
     }
 
     void init()
@@ -10,6 +10,8 @@ import x86_64.system.ioapic;
 import x86_64.system.pic;
 import x86_64.system.idt;
 import system.acpi;
+import system.cpu.self;
+import system.rcu;
 import lib;
 import cppstd;
 
@@ -49,6 +51,46 @@ namespace interrupts
         return idt::handler_at(cpuidx, vector);
     }
 
+    std::size_t count(std::size_t cpuidx, std::size_t vector)
+    {
+        lib::bug_on(vector >= idt::num_ints || cpuidx >= cpu::count());
+        return idt::count_at(cpuidx, vector);
+    }
+
+    bool route(std::size_t vector, std::size_t from, std::size_t to)
+    {
+        lib::bug_on(from >= cpu::count() || to >= cpu::count());
+
+        // can come from userspace through set_affinity
+        if (vector < idt::irq(0) || vector >= idt::num_ints)
+            return false;
+
+        if (from == to)
+            return true;
+
+        // legacy pic can only deliver to the bsp
+        if (!apic::io::is_initialised())
+            return false;
+
+        auto &src = idt::handler_at(from, vector).value().get();
+        auto &dst = idt::handler_at(to, vector).value().get();
+        if (!src.used() || dst.used() || dst.is_reserved())
+            return false;
+
+        // keep the old handler until interrupts in flight to the old cpu are done
+        dst = src;
+        if (!apic::io::set_dest(vector, cpu::nth(to)->arch_id))
+        {
+            dst.reset_all();
+            return false;
+        }
+
+        // a cpu can't pass a quiescent state inside an interrupt handler
+        rcu::synchronize();
+        src.reset_all();
+        return true;
+    }
+
     void mask(std::size_t vector)
     {
         lib::bug_on(vector < idt::irq(0) || vector >= idt::num_ints);
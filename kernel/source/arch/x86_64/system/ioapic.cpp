@@ -86,6 +86,14 @@ namespace x86_64::apic::io
                 write_entry(idx, entry);
             }
 
+            void set_dest(std::size_t idx, std::size_t dest) const
+            {
+                auto entry = read_entry(idx);
+                entry &= ~(0xFFull << 56);
+                entry |= (static_cast<std::uint64_t>(dest) << 56);
+                write_entry(idx, entry);
+            }
+
             void mask(std::size_t idx) const
             {
                 auto entry = read_entry(idx);
@@ -179,6 +187,27 @@ namespace x86_64::apic::io
             unmask_gsi(vector - 0x20);
     }
 
+    bool set_dest(std::uint8_t vector, std::size_t dest)
+    {
+        lib::bug_on(vector < 0x20);
+
+        if (dest > 0xFF)
+            return false;
+
+        const auto gsi = irq2iso(vector - 0x20).value_or(vector - 0x20);
+        for (const auto &entry : ioapics)
+        {
+            auto [start, end] = entry.gsi_range();
+            if (start <= gsi && gsi < end)
+            {
+                log::debug("ioapic: moving gsi {} to lapic {}", gsi, dest);
+                entry.set_dest(gsi - start, dest);
+                return true;
+            }
+        }
+        return false;
+    }
+
     void init()
     {
         log::info("ioapic: setting up");
@@ -0,0 +1,29 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module system.smp;
+
+import x86_64.system.lapic;
+import system.interrupts;
+import system.cpu.self;
+import system.cpu;
+import lib;
+import cppstd;
+
+namespace smp::arch
+{
+    static constexpr std::size_t call_vector = 0xFD;
+
+    bool init()
+    {
+        auto [handler, vector] = interrupts::allocate(cpu::self()->idx, call_vector).value();
+        lib::bug_on(vector != call_vector);
+        handler.set([](cpu::registers *) { handle(); });
+        return true;
+    }
+
+    void send(std::size_t cpu)
+    {
+        const auto id = static_cast<std::uint32_t>(cpu::local::nth(cpu)->arch_id);
+        x86_64::apic::ipi(id, x86_64::apic::destination::physical, x86_64::apic::delivery::fixed, call_vector);
+    }
+} // namespace smp::arch
@@ -153,7 +153,10 @@ namespace cpu::mp
             for (std::size_t i = 0; i < 1000; i++)
             {
                 if (__atomic_load_n(&info->booted_flag, __ATOMIC_RELAXED) == 1)
+                {
+                    arch::core::booting(cpu->idx);
                     return;
+                }
                 time::stall_ns(300'000);
             }
             lib::panic("could not boot up a core");
@@ -2,6 +2,8 @@
 
 module system.pci;
 
+import system.cpu.self;
+import system.cpu;
 import lib;
 import cppstd;
 
@@ -131,6 +133,19 @@ namespace pci
         lib::initgraph::stage *ios_discovered_stage();
         lib::initgraph::stage *rbs_discovered_stage();
 
+        auto msi_message(std::size_t cpu, std::size_t vector) -> std::optional<std::pair<std::uint64_t, std::uint32_t>>
+        {
+            // destination ids above 255 need interrupt remapping
+            const auto id = cpu::nth(cpu)->arch_id;
+            if (id > 0xFF || vector > 0xFF)
+                return std::nullopt;
+
+            // fixed delivery, edge triggered, physical destination
+            const std::uint64_t addr = 0xFEE00000 | (id << 12);
+            const std::uint32_t data = vector;
+            return std::make_pair(addr, data);
+        }
+
         lib::initgraph::task ios_task
         {
             "pci.arch.discover-ios",
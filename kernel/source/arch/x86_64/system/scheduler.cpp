@@ -6,8 +6,10 @@ import x86_64.system.lapic;
 import x86_64.system.gdt;
 import x86_64.system.idt;
 import system.interrupts;
+import system.hrtimer;
 import system.memory;
 import system.cpu.self;
+import system.time;
 import system.cpu;
 import magic_enum;
 import arch;
@@ -24,6 +26,18 @@ namespace sched::arch
 {
     static constexpr std::size_t sched_vector = 0xFE;
 
+    namespace
+    {
+        void send_self()
+        {
+            x86_64::apic::ipi(x86_64::apic::shorthand::self, x86_64::apic::delivery::fixed, sched_vector);
+        }
+
+        // the lapic timer belongs to hrtimer, the tick is one of its timers
+        cpu_local<hrtimer::timer> tick;
+        cpu_local_init(tick, send_self);
+    } // namespace
+
     void init()
     {
         x86_64::idt::table()[sched_vector].ist = 2;
@@ -34,9 +48,81 @@ namespace sched::arch
     void reschedule(std::size_t ms)
     {
         if (ms == 0)
-            x86_64::apic::ipi(x86_64::apic::shorthand::self, x86_64::apic::delivery::fixed, sched_vector);
+            send_self();
+        else
+            hrtimer::arm(tick.get(), time::main_clock()->ns() + ms * 1'000'000);
+    }
+
+    void kick(std::size_t cpu_idx)
+    {
+        const auto id = static_cast<std::uint32_t>(cpu::local::nth(cpu_idx)->arch_id);
+        x86_64::apic::ipi(id, x86_64::apic::destination::physical, x86_64::apic::delivery::fixed, sched_vector);
+    }
+
+    namespace
+    {
+        struct mwait_info
+        {
+            bool supported = false;
+            std::uint32_t deep_hint = 0;
+        };
+
+        const mwait_info &mwait()
+        {
+            static const auto cached = [] {
+                mwait_info info { };
+
+                cpu::id_res res;
+                if (!cpu::id(1, 0, res) || !(res.c & (1 << 3)))
+                    return info;
+
+                // hints can only be used if the mwait extensions are enumerated
+                if (!cpu::id(5, 0, res) || !(res.c & (1 << 0)))
+                    return info;
+
+                info.supported = true;
+
+                // edx has the number of sub-states of each c-state in 4 bit fields
+                for (std::uint32_t cstate = 7; cstate > 0; cstate--)
+                {
+                    const auto substates = (res.d >> (cstate * 4)) & 0xF;
+                    if (substates != 0)
+                    {
+                        info.deep_hint = ((cstate - 1) << 4) | (substates - 1);
+                        break;
+                    }
+                }
+                return info;
+            } ();
+            return cached;
+        }
+    } // namespace
+
+    bool can_monitor()
+    {
+        return mwait().supported;
+    }
+
+    void idle_wait(const std::atomic_bool &flag, bool deep)
+    {
+        if (mwait().supported)
+        {
+            asm volatile ("monitor" :: "a"(&flag), "c"(0), "d"(0) : "memory");
+            if (!flag.load())
+            {
+                const std::uint32_t hint = deep ? mwait().deep_hint : 0;
+                asm volatile ("mwait" :: "a"(hint), "c"(0) : "memory");
+            }
+            return;
+        }
+
+        // sti only takes effect after the next instruction,
+        // so an interrupt can not slip in between the check and hlt
+        asm volatile ("cli" ::: "memory");
+        if (!flag.load())
+            asm volatile ("sti; hlt" ::: "memory");
         else
-            x86_64::apic::arm(ms * 1'000'000, sched_vector);
+            asm volatile ("sti" ::: "memory");
     }
 
     void finalise(process *proc, thread *thread, std::uintptr_t ip)
@@ -48,8 +134,9 @@ namespace sched::arch
         regs.rip = ip;
 
         const auto &fpu = cpu::features::get_fpu();
-        thread->fpu = lib::allocz<std::byte *>(fpu.size);
+        thread->fpu = thread->arch_state();
         thread->fpu_size = fpu.size;
+        std::memset(thread->fpu, 0, fpu.size);
 
         if (thread->is_user)
         {
@@ -79,8 +166,8 @@ namespace sched::arch
 
     void deinitialise(process *proc, thread *thread)
     {
-        lib::unused(proc);
-        lib::free(thread->fpu);
+        // the fpu area is freed along with the thread
+        lib::unused(proc, thread);
     }
 
     void save(thread *thread)
@@ -112,4 +199,9 @@ namespace sched::arch
     {
         thread->regs.rsp = addr;
     }
+
+    std::size_t state_size()
+    {
+        return cpu::features::get_fpu().size;
+    }
 } // namespace sched::arch
\ No newline at end of file
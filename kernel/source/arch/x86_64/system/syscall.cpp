@@ -45,13 +45,22 @@ namespace x86_64::syscall
         [20] = { "writev", vfs::writev },
         [21] = { "access", vfs::access },
         [23] = { "select", proc::select },
+        [24] = { "sched_yield", proc::sched_yield },
+        [25] = { "mremap", memory::mremap },
+        [28] = { "madvise", memory::madvise },
         [32] = { "dup", vfs::dup },
         [33] = { "dup2", vfs::dup2 },
+        [35] = { "nanosleep", time::nanosleep },
+        [36] = { "getitimer", time::getitimer },
+        [37] = { "alarm", time::alarm },
+        [38] = { "setitimer", time::setitimer },
         [39] = { "getpid", proc::getpid },
         [63] = { "uname", misc::uname },
         [72] = { "fcntl", vfs::fcntl },
+        [77] = { "ftruncate", vfs::ftruncate },
         [79] = { "getcwd", vfs::getcwd, [](std::uintptr_t val) { return val == 0; } },
         [85] = { "creat", vfs::creat },
+        [96] = { "gettimeofday", time::gettimeofday },
         [102] = { "getuid", proc::getuid },
         [104] = { "getgid", proc::getgid },
         [107] = { "geteuid", proc::geteuid },
@@ -61,19 +70,48 @@ namespace x86_64::syscall
         [118] = { "getresuid", proc::getresuid },
         [120] = { "getresgid", proc::getresgid },
         [121] = { "getpgid", proc::getpgid },
+        [142] = { "sched_setparam", proc::sched_setparam },
+        [143] = { "sched_getparam", proc::sched_getparam },
+        [144] = { "sched_setscheduler", proc::sched_setscheduler },
+        [145] = { "sched_getscheduler", proc::sched_getscheduler },
+        [146] = { "sched_get_priority_max", proc::sched_get_priority_max },
+        [147] = { "sched_get_priority_min", proc::sched_get_priority_min },
+        [148] = { "sched_rr_get_interval", proc::sched_rr_get_interval },
+        [149] = { "mlock", memory::mlock },
+        [150] = { "munlock", memory::munlock },
+        [151] = { "mlockall", memory::mlockall },
+        [152] = { "munlockall", memory::munlockall },
         [158] = { "arch_prctl", arch::arch_prctl },
+        [165] = { "mount", vfs::mount },
         [186] = { "gettid", proc::gettid },
+        [201] = { "time", time::time },
         [202] = { "futex", proc::futex },
+        [203] = { "sched_setaffinity", proc::sched_setaffinity },
+        [204] = { "sched_getaffinity", proc::sched_getaffinity },
+        [217] = { "getdents64", vfs::getdents64 },
+        [222] = { "timer_create", time::timer_create },
+        [223] = { "timer_settime", time::timer_settime },
+        [224] = { "timer_gettime", time::timer_gettime },
+        [225] = { "timer_getoverrun", time::timer_getoverrun },
+        [226] = { "timer_delete", time::timer_delete },
+        [227] = { "clock_settime", time::clock_settime },
         [228] = { "clock_gettime", time::clock_gettime },
+        [229] = { "clock_getres", time::clock_getres },
+        [230] = { "clock_nanosleep", time::clock_nanosleep },
         [231] = { "exit_group", proc::exit_group },
         [257] = { "openat", vfs::openat },
         [262] = { "fstatat", vfs::fstatat },
         [269] = { "faccessat", vfs::faccessat },
         [270] = { "pselect6", proc::pselect },
+        [283] = { "timerfd_create", time::timerfd_create },
+        [286] = { "timerfd_settime", time::timerfd_settime },
+        [287] = { "timerfd_gettime", time::timerfd_gettime },
         [292] = { "dup3", vfs::dup3 },
         [295] = { "preadv", vfs::preadv },
         [296] = { "pwritev", vfs::pwritev },
-        [302] = { "prlimit", proc::prlimit }
+        [302] = { "prlimit", proc::prlimit },
+        [309] = { "getcpu", proc::getcpu },
+        [319] = { "memfd_create", vfs::memfd_create }
     };
 
     cpu_local<bool> in_syscall;
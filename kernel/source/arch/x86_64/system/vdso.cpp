@@ -0,0 +1,65 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module;
+
+#include <vdso/data.h>
+
+module system.vdso;
+
+import x86_64.drivers.timers.kvm;
+import x86_64.drivers.timers.tsc;
+import system.time;
+import system.cpu;
+import lib;
+import cppstd;
+
+namespace vdso::arch
+{
+    namespace
+    {
+        constexpr std::uint8_t vdso_image[] {
+            #embed <vdso.so>
+        };
+    } // namespace
+
+    std::span<const std::byte> image()
+    {
+        return std::as_bytes(std::span { vdso_image });
+    }
+
+    void update(vdso_data &data)
+    {
+        using namespace x86_64::timers;
+
+        data.mode = vdso_mode_none;
+        data.has_tsc_aux = tsc::aux_supported();
+
+        // both modes find out which cpu they are on with rdtscp
+        const auto clock = time::main_clock();
+        if (clock == nullptr || !data.has_tsc_aux)
+            return;
+
+        if (clock->ns == kvm::time_ns)
+        {
+            data.pvclock_offset = kvm::clock_offset();
+            data.mode = vdso_mode_pvclock;
+        }
+        else if (clock->ns == tsc::time_ns)
+        {
+            const auto freq = tsc::frequency();
+            data.tsc_mult = freq.mult();
+            data.tsc_shift = freq.shift();
+
+            for (std::size_t i = 0; i < cpu::count(); i++)
+                data.cpu_offset[i] = tsc::offset_of(i);
+            data.mode = vdso_mode_tsc;
+        }
+    }
+
+    std::uintptr_t pvclock_page(std::size_t cpuidx)
+    {
+        if (!x86_64::timers::kvm::supported())
+            return 0;
+        return x86_64::timers::kvm::pvclock_page(cpuidx);
+    }
+} // namespace vdso::arch
@@ -74,10 +74,11 @@ namespace fs::dev::mem
             return true;
         }
 
+        // every mapping gets its own anonymous memory. reads are served by the zero page
         std::shared_ptr<vmm::object> map(std::shared_ptr<vfs::file> file, bool priv) override
         {
             lib::unused(file, priv);
-            return nullptr;
+            return std::make_shared<vmm::memobject>();
         }
 
         bool sync() override { return true; }
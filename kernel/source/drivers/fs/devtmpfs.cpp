@@ -96,4 +96,22 @@ namespace fs::devtmpfs
             lib::panic_if(!merr, "devtmpfs: failed to mount devtmpfs at '/dev': {}", magic_enum::enum_name(merr.error()));
         }
     };
+
+    // posix shared memory objects from shm_open live here
+    lib::initgraph::task shm_mount_task
+    {
+        "vfs.devtmpfs.mount-shm",
+        lib::initgraph::postsched_init_engine,
+        lib::initgraph::require { mounted_stage(), tmpfs::registered_stage() },
+        [] {
+            const auto mode = static_cast<mode_t>(stat::type::s_ifdir) | s_isvtx | s_irwxu | s_irwxg | s_irwxo;
+            const auto cerr = vfs::create(std::nullopt, "/dev/shm", mode);
+            lib::panic_if(
+                !cerr && cerr.error() != vfs::error::already_exists,
+                "devtmpfs: failed to create directory '/dev/shm': {}", magic_enum::enum_name(cerr.error())
+            );
+            const auto merr = vfs::mount("", "/dev/shm", "tmpfs", 0);
+            lib::panic_if(!merr, "devtmpfs: failed to mount tmpfs at '/dev/shm': {}", magic_enum::enum_name(merr.error()));
+        }
+    };
 } // namespace fs::devtmpfs
\ No newline at end of file
@@ -3,6 +3,7 @@
 module drivers.fs;
 
 import drivers.fs.devtmpfs;
+import drivers.fs.procfs;
 import drivers.fs.tmpfs;
 import lib;
 
@@ -22,7 +23,11 @@ namespace fs
     {
         "vfs.fs.register",
         lib::initgraph::postsched_init_engine,
-        lib::initgraph::require { tmpfs::registered_stage(), devtmpfs::registered_stage() },
+        lib::initgraph::require {
+            tmpfs::registered_stage(),
+            devtmpfs::registered_stage(),
+            procfs::registered_stage()
+        },
         lib::initgraph::entail { registered_stage() },
         [] { }
     };
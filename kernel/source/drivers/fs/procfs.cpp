@@ -0,0 +1,173 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module drivers.fs.procfs;
+
+import drivers.fs.tmpfs;
+import system.vfs;
+import magic_enum;
+import lib;
+import cppstd;
+
+namespace fs::procfs
+{
+    struct generated_ops : vfs::ops
+    {
+        std::function<std::string ()> generate;
+        std::function<bool (std::string_view)> store;
+
+        generated_ops(std::function<std::string ()> generate, std::function<bool (std::string_view)> store)
+            : generate { std::move(generate) }, store { std::move(store) } { }
+
+        std::ssize_t read(std::shared_ptr<vfs::file> file, std::uint64_t offset, std::span<std::byte> buffer) override
+        {
+            lib::unused(file);
+
+            const auto text = generate();
+            if (offset >= text.size())
+                return 0;
+
+            const auto size = std::min(buffer.size_bytes(), text.size() - offset);
+            std::memcpy(buffer.data(), text.data() + offset, size);
+            return size;
+        }
+
+        std::ssize_t write(std::shared_ptr<vfs::file> file, std::uint64_t offset, std::span<std::byte> buffer) override
+        {
+            lib::unused(file, offset);
+            if (!store)
+                return (errno = EINVAL, -1);
+
+            // each write is a whole command, wherever the cursor is
+            std::string_view text { reinterpret_cast<const char *>(buffer.data()), buffer.size() };
+            while (!text.empty() && (text.back() == '\n' || text.back() == ' '))
+                text.remove_suffix(1);
+
+            if (!store(text))
+                return (errno = EINVAL, -1);
+            return buffer.size();
+        }
+
+        bool trunc(std::shared_ptr<vfs::file> file, std::size_t size) override
+        {
+            lib::unused(file, size);
+            return false;
+        }
+
+        std::shared_ptr<vmm::object> map(std::shared_ptr<vfs::file> file, bool priv) override
+        {
+            lib::unused(file, priv);
+            return nullptr;
+        }
+
+        bool sync() override { return true; }
+    };
+
+    struct fs : vfs::filesystem
+    {
+        lib::locked_ptr<tmpfs::fs::instance, lib::mutex> instance;
+        std::shared_ptr<vfs::dentry> root;
+        mutable std::list<std::shared_ptr<struct vfs::mount>> mounts;
+
+        auto mount(std::shared_ptr<vfs::dentry> src) const -> vfs::expect<std::shared_ptr<struct vfs::mount>> override
+        {
+            lib::unused(src);
+
+            auto mount = std::make_shared<struct vfs::mount>(instance, root, std::nullopt);
+            mounts.push_back(mount);
+            return mount;
+        }
+
+        fs() : vfs::filesystem { "proc" }
+        {
+            instance = lib::make_locked<tmpfs::fs::instance, lib::mutex>();
+            auto locked = instance.lock();
+
+            root = std::make_shared<vfs::dentry>();
+            root->name = "procfs root. this shouldn't be visible anywhere";
+            root->inode = std::make_shared<tmpfs::inode>(
+                locked->dev_id, locked->next_inode++,
+                static_cast<mode_t>(stat::type::s_ifdir),
+                tmpfs::ops::singleton()
+            );
+        }
+    };
+
+    std::unique_ptr<vfs::filesystem> init()
+    {
+        static bool once_flag = false;
+        if (once_flag)
+            lib::panic("procfs: tried to initialise twice");
+
+        once_flag = true;
+        return std::unique_ptr<vfs::filesystem> { new fs };
+    }
+
+    bool create(std::string_view name, std::function<std::string ()> generate)
+    {
+        return create(name, std::move(generate), { });
+    }
+
+    bool create(std::string_view name, std::function<std::string ()> generate, std::function<bool (std::string_view)> store)
+    {
+        auto mode = static_cast<mode_t>(stat::type::s_ifreg) | s_irusr | s_irgrp | s_iroth;
+        if (store)
+            mode |= s_iwusr;
+
+        std::string path { "/proc/" };
+        path.append(name);
+
+        const auto ret = vfs::create(std::nullopt, std::move(path), mode);
+        if (!ret)
+            return false;
+
+        ret->dentry->inode->op = std::make_shared<generated_ops>(std::move(generate), std::move(store));
+        return true;
+    }
+
+    lib::initgraph::stage *registered_stage()
+    {
+        static lib::initgraph::stage stage
+        {
+            "vfs.procfs.registered",
+            lib::initgraph::postsched_init_engine
+        };
+        return &stage;
+    }
+
+    lib::initgraph::stage *mounted_stage()
+    {
+        static lib::initgraph::stage stage
+        {
+            "vfs.procfs.mounted",
+            lib::initgraph::postsched_init_engine
+        };
+        return &stage;
+    }
+
+    lib::initgraph::task register_task
+    {
+        "vfs.procfs.register",
+        lib::initgraph::postsched_init_engine,
+        lib::initgraph::entail { registered_stage() },
+        [] {
+            lib::bug_on(!vfs::register_fs(procfs::init()));
+        }
+    };
+
+    lib::initgraph::task mount_task
+    {
+        "vfs.procfs.mount",
+        lib::initgraph::postsched_init_engine,
+        lib::initgraph::require { vfs::root_mounted_stage(), registered_stage() },
+        lib::initgraph::entail { mounted_stage() },
+        [] {
+            const auto cerr = vfs::create(std::nullopt, "/proc", stat::type::s_ifdir);
+            lib::panic_if(
+                !cerr && cerr.error() != vfs::error::already_exists,
+                "procfs: failed to create directory '/proc': {}", magic_enum::enum_name(cerr.error())
+            );
+            const auto merr = vfs::mount("", "/proc", "proc", 0);
+            lib::panic_if(!merr, "procfs: failed to mount procfs at '/proc': {}", magic_enum::enum_name(merr.error()));
+        }
+    };
+} // namespace fs::procfs
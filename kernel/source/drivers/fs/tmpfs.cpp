@@ -60,6 +60,11 @@ namespace fs::tmpfs
         const std::unique_lock _ { inod->lock };
 
         auto size = buffer.size_bytes();
+        if (inod->seals & (vfs::f_seal_write | vfs::f_seal_future_write))
+            return -EPERM;
+        if ((inod->seals & vfs::f_seal_grow) && offset + size > static_cast<std::size_t>(inod->stat.st_size))
+            return -EPERM;
+
         inod->memory->write(offset, buffer.subspan(0, size));
 
         if (offset + size >= static_cast<std::size_t>(inod->stat.st_size))
@@ -79,6 +84,11 @@ namespace fs::tmpfs
         if (size == current_size)
             return true;
 
+        if ((inod->seals & vfs::f_seal_shrink) && size < current_size)
+            return false;
+        if ((inod->seals & vfs::f_seal_grow) && size > current_size)
+            return false;
+
         if (size < current_size)
             inod->memory->clear(size, 0, current_size - size);
         else
@@ -103,6 +113,41 @@ namespace fs::tmpfs
         return inod->memory;
     }
 
+    int ops::add_seals(std::shared_ptr<vfs::file> file, int seals)
+    {
+        auto inod = reinterpret_cast<inode *>(file->path.dentry->inode.get());
+        const std::unique_lock _ { inod->lock };
+
+        if (seals & ~vfs::all_seals)
+            return (errno = EINVAL, -1);
+
+        if (!vfs::is_write(file->flags) || (inod->seals & vfs::f_seal_seal))
+            return (errno = EPERM, -1);
+
+        // every shared mapping holds a reference to the memory object.
+        // we can't tell writable ones apart, so refuse while any exists
+        if ((seals & vfs::f_seal_write) && !(inod->seals & vfs::f_seal_write) && inod->memory.use_count() > 1)
+            return (errno = EBUSY, -1);
+
+        inod->seals |= seals;
+        return 0;
+    }
+
+    int ops::get_seals(std::shared_ptr<vfs::file> file)
+    {
+        auto inod = reinterpret_cast<inode *>(file->path.dentry->inode.get());
+        const std::unique_lock _ { inod->lock };
+        return inod->seals;
+    }
+
+    // everything lives in the dentry cache, which devtmpfs shares
+    int ops::readdir(std::shared_ptr<vfs::file> file, vfs::dir_context &ctx)
+    {
+        if (file->path.dentry->inode->stat.type() != stat::type::s_ifdir)
+            return (errno = ENOTDIR, -1);
+        return vfs::dcache_readdir(file->path, ctx);
+    }
+
     bool ops::sync() { return true; }
 
     auto fs::instance::create(std::shared_ptr<vfs::inode> &parent, std::string_view name, mode_t mode, std::shared_ptr<vfs::ops> ops) -> vfs::expect<std::shared_ptr<vfs::inode>>
@@ -175,6 +220,59 @@ namespace fs::tmpfs
         return std::unique_ptr<vfs::filesystem> { new fs { } };
     }
 
+    namespace
+    {
+        std::shared_ptr<struct vfs::mount> anon_mount;
+    } // namespace
+
+    namespace
+    {
+        auto make_anonymous(std::string_view name, mode_t mode, std::shared_ptr<vfs::ops> ops) -> vfs::expect<std::pair<vfs::path, inode *>>
+        {
+            lib::bug_on(!anon_mount);
+
+            auto parent = anon_mount->root->inode;
+
+            auto locked = anon_mount->fs.lock();
+            auto node = locked->create(parent, name, mode, ops);
+            if (!node)
+                return std::unexpected { node.error() };
+
+            // never linked into the tree, lives as long as something references it
+            auto dentry = std::make_shared<vfs::dentry>();
+            dentry->name = std::string { name };
+            dentry->inode = node.value();
+            dentry->parent = anon_mount->root;
+
+            return std::pair { vfs::path { anon_mount, dentry }, reinterpret_cast<inode *>(node->get()) };
+        }
+    } // namespace
+
+    auto create_anonymous(std::string_view name, bool sealable, bool huge) -> vfs::expect<vfs::path>
+    {
+        const auto mode = static_cast<mode_t>(stat::type::s_ifreg) | s_irwxu;
+        auto ret = make_anonymous(name, mode, nullptr);
+        if (!ret)
+            return std::unexpected { ret.error() };
+
+        auto [path, inod] = ret.value();
+        if (sealable)
+            inod->seals = 0;
+        if (huge)
+            inod->memory = std::make_shared<vmm::memobject>(true);
+
+        return path;
+    }
+
+    auto create_anonymous(std::string_view name, std::shared_ptr<vfs::ops> ops) -> vfs::expect<vfs::path>
+    {
+        lib::bug_on(!ops);
+        auto ret = make_anonymous(name, static_cast<mode_t>(s_irusr | s_iwusr), std::move(ops));
+        if (!ret)
+            return std::unexpected { ret.error() };
+        return ret->first;
+    }
+
     lib::initgraph::stage *registered_stage()
     {
         static lib::initgraph::stage stage
@@ -194,4 +292,19 @@ namespace fs::tmpfs
             lib::bug_on(!vfs::register_fs(tmpfs::init()));
         }
     };
+
+    lib::initgraph::task anon_mount_task
+    {
+        "vfs.tmpfs.mount-anonymous",
+        lib::initgraph::postsched_init_engine,
+        lib::initgraph::require { registered_stage() },
+        [] {
+            const auto fs = vfs::find_fs("tmpfs");
+            lib::bug_on(!fs);
+
+            const auto mnt = fs->get()->mount(nullptr);
+            lib::panic_if(!mnt, "tmpfs: failed to create the anonymous instance");
+            anon_mount = mnt.value();
+        }
+    };
 } // namespace fs::tmpfs
\ No newline at end of file
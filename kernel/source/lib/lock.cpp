@@ -14,8 +14,42 @@ namespace lib::lock
     {
         cpu_local<std::atomic_size_t> irq_depth;
         cpu_local_init(irq_depth, 0uz);
+
+        cpu_local<bool> irq_saved;
+        cpu_local_init(irq_saved, false);
+
+        // task, softirq, irq and nmi
+        constexpr std::size_t max_nesting = 4;
+
+        struct qnodes
+        {
+            std::array<qnode, max_nesting> nodes;
+            std::atomic_size_t depth = 0;
+        };
+        cpu_local<qnodes> nodes;
+        cpu_local_init(nodes);
     } // namespace
 
+    qnode *get_qnode()
+    {
+        if (!cpu::local::available())
+            return nullptr;
+
+        const auto idx = nodes->depth.fetch_add(1, std::memory_order_relaxed);
+        if (idx >= max_nesting)
+        {
+            // too deep, the caller spins on the lock word instead
+            nodes->depth.fetch_sub(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &nodes->nodes[idx];
+    }
+
+    void put_qnode()
+    {
+        nodes->depth.fetch_sub(1, std::memory_order_relaxed);
+    }
+
     bool acquire_irq()
     {
         const auto ret = arch::int_status();
@@ -45,11 +79,48 @@ namespace lib::lock
             arch::int_switch(old);
     }
 
+    void save_irq()
+    {
+        if (!cpu::local::available())
+            return;
+
+        if (cpu::self()->in_interrupt.load(std::memory_order_acquire))
+            return;
+
+        const auto old = arch::int_switch_status(false);
+        if (irq_depth->fetch_add(1, std::memory_order_acquire) == 0)
+            irq_saved = old;
+    }
+
+    void restore_irq()
+    {
+        if (!cpu::local::available())
+            return;
+
+        if (cpu::self()->in_interrupt.load(std::memory_order_acquire))
+            return;
+
+        if (irq_depth->fetch_sub(1, std::memory_order_release) == 1)
+            arch::int_switch(irq_saved.get());
+    }
+
     void acquire_preempt() { sched::disable(); }
     void release_preempt() { sched::enable(); }
 
     void pause() { arch::pause(); }
 
+    bool can_sleep()
+    {
+        return sched::is_initialised();
+    }
+
+    std::size_t cpu_index()
+    {
+        if (!cpu::local::available())
+            return 0;
+        return cpu::self()->idx;
+    }
+
     // auto clock() -> std::uint64_t (*)();
     std::uint64_t (*clock())()
     {
@@ -0,0 +1,218 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module lib;
+
+import system.scheduler;
+import system.rcu;
+import system.cpu.self;
+import arch;
+import cppstd;
+
+namespace lib
+{
+    namespace
+    {
+        // owner of the mutexes taken before the scheduler is up
+        constinit sched::thread_base boot_owner { };
+
+        std::uintptr_t current()
+        {
+            if (!sched::is_initialised())
+                return reinterpret_cast<std::uintptr_t>(&boot_owner);
+            return reinterpret_cast<std::uintptr_t>(static_cast<sched::thread_base *>(sched::this_thread()));
+        }
+
+        // has to be called under rcu::read_lock. the reaper waits for a grace
+        // period before freeing threads, so the owner can't be freed under us
+        bool is_running(std::uintptr_t owner)
+        {
+            const auto base = reinterpret_cast<sched::thread_base *>(owner);
+            if (base == &boot_owner)
+                return false;
+
+            const auto thread = static_cast<sched::thread *>(base);
+            return thread->status == sched::status::running && thread->running_on != cpu::self();
+        }
+    } // namespace
+
+    bool mutex::try_acquire(std::uintptr_t me)
+    {
+        std::uintptr_t expected = 0;
+        return _owner.compare_exchange_strong(
+            expected, me,
+            std::memory_order_acquire,
+            std::memory_order_relaxed
+        );
+    }
+
+    bool mutex::spin_on_owner(std::uintptr_t me)
+    {
+        const rcu::guard _;
+        while (true)
+        {
+            const auto owner = _owner.load(std::memory_order_relaxed);
+            if (owner == 0)
+            {
+                if (try_acquire(me))
+                    return true;
+                continue;
+            }
+
+            // don't jump the queue, and don't burn cpu on a sleeping owner
+            if ((owner & has_waiters) || !is_running(owner))
+                return false;
+
+            arch::pause();
+        }
+    }
+
+    void mutex::lock_slow(std::uintptr_t me)
+    {
+        if (!sched::is_initialised())
+        {
+            while (!try_acquire(me))
+                arch::pause();
+            return;
+        }
+
+        if (spin_on_owner(me))
+            return;
+
+        waiter node { reinterpret_cast<sched::thread_base *>(me), nullptr, false };
+        bool queued = false;
+
+        const auto thread = sched::this_thread();
+        _wait_lock.lock();
+        while (true)
+        {
+            if (node.granted)
+                break;
+
+            if (!queued)
+            {
+                auto owner = _owner.load(std::memory_order_relaxed);
+                if (owner == 0)
+                {
+                    if (try_acquire(me))
+                        break;
+                    continue;
+                }
+
+                // unlock must now take the slow path and find us
+                if (!_owner.compare_exchange_strong(
+                    owner, owner | has_waiters,
+                    std::memory_order_relaxed,
+                    std::memory_order_relaxed))
+                    continue;
+
+                if (_tail != nullptr)
+                    _tail->next = &node;
+                else
+                    _head = &node;
+                _tail = &node;
+                queued = true;
+            }
+
+            // unlock can't wake us before we are off the cpu, wake_up
+            // waits on the sleep lock held from here until then
+            thread->prepare_sleep();
+            _wait_lock.unlock();
+            sched::yield();
+            _wait_lock.lock();
+        }
+        _wait_lock.unlock();
+    }
+
+    void mutex::unlock_slow()
+    {
+        _wait_lock.lock();
+
+        const auto next = _head;
+        if (next == nullptr)
+        {
+            _owner.store(0, std::memory_order_release);
+            _wait_lock.unlock();
+            return;
+        }
+
+        _head = next->next;
+        if (_head == nullptr)
+            _tail = nullptr;
+
+        // hand over directly, nobody can steal it in between
+        const auto thread = next->thread;
+        auto owner = reinterpret_cast<std::uintptr_t>(thread);
+        if (_head != nullptr)
+            owner |= has_waiters;
+
+        _owner.store(owner, std::memory_order_release);
+        next->granted = true;
+
+        _wait_lock.unlock();
+        static_cast<sched::thread *>(thread)->wake_up(0);
+    }
+
+    void mutex::lock()
+    {
+        const auto me = current();
+        if (!try_acquire(me))
+            lock_slow(me);
+    }
+
+    bool mutex::unlock()
+    {
+        auto owner = _owner.load(std::memory_order_relaxed);
+        if (owner == 0)
+            return false;
+
+        if (owner & has_waiters)
+        {
+            unlock_slow();
+            return true;
+        }
+
+        if (!_owner.compare_exchange_strong(
+            owner, 0,
+            std::memory_order_release,
+            std::memory_order_relaxed))
+            unlock_slow();
+
+        return true;
+    }
+
+    bool mutex::try_lock()
+    {
+        return try_acquire(current());
+    }
+
+    bool mutex::try_lock_until(std::uint64_t ns)
+    {
+        const auto me = current();
+        if (try_acquire(me))
+            return true;
+
+        const auto clock = lock::clock();
+        if (clock == nullptr)
+            return false;
+
+        const auto target = clock() + ns;
+        while (!try_acquire(me))
+        {
+            if (clock() >= target)
+                return false;
+
+            bool spin;
+            {
+                const rcu::guard _;
+                const auto owner = _owner.load(std::memory_order_relaxed) & ~has_waiters;
+                spin = owner == 0 || is_running(owner);
+            }
+
+            if (spin)
+                arch::pause();
+            else
+                sched::yield();
+        }
+        return true;
+    }
+} // namespace lib
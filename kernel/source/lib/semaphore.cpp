@@ -59,17 +59,42 @@ namespace lib
 
     bool semaphore::wait_for(std::size_t ms)
     {
-        do {
-            if (test())
-                return true;
-            auto eep = std::min(static_cast<std::ssize_t>(ms), 10z);
-            ms -= eep;
+        return wait_for_ns(ms * 1'000'000);
+    }
+
+    bool semaphore::wait_for_ns(std::size_t ns)
+    {
+        if (ns == 0)
+            return test();
+
+        const bool ints = arch::int_switch_status(false);
+        lock.lock();
+
+        auto me = sched::this_thread();
+
+        bool ret = true;
+        if (--signals < 0)
+        {
+            threads.push_back(me);
+            me->prepare_sleep_ns(ns);
+            lock.unlock();
+
+            sched::yield();
 
-            if (eep)
-                sched::sleep_for(eep);
-        } while (ms);
+            // still queued means nobody signalled before the timeout
+            lock.lock();
+            auto it = std::remove(threads.begin(), threads.end(), me);
+            if (it != threads.end())
+            {
+                threads.erase(it);
+                signals++;
+                ret = false;
+            }
+        }
 
-        return false;
+        lock.unlock();
+        arch::int_switch(ints);
+        return ret;
     }
 
     void semaphore::signal(bool drop)
@@ -84,18 +109,18 @@ namespace lib
             return;
         }
 
-        sched::thread *thread = nullptr;
         if (++signals <= 0)
         {
             lib::bug_on(threads.size() == 0);
-            thread = static_cast<sched::thread *>(threads.front());
+            const auto thread = static_cast<sched::thread *>(threads.front());
             threads.pop_front();
+
+            // under the lock, so a waiter that timed out can't have moved on
+            // to sleep somewhere else by the time this wakes it up
+            thread->wake_up(0);
         }
 
         lock.unlock();
         arch::int_switch(ints);
-
-        if (thread)
-            thread->wake_up(0);
     }
 } // namespace lib
\ No newline at end of file
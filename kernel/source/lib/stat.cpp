@@ -7,10 +7,19 @@ import cppstd;
 
 void stat::update_time(std::uint8_t flags)
 {
+    // the coarse clock is only as fine as the scheduler tick, but it is
+    // a plain load and most updates then find nothing to store
+    const auto now = ::time::now(::time::realtime_coarse);
+
+    const auto update = [&now](timespec &ts) {
+        if (ts != now)
+            ts = now;
+    };
+
     if (flags & time::access)
-        st_atim = ::time::now();
+        update(st_atim);
     if (flags & time::modify)
-        st_mtim = ::time::now();
+        update(st_mtim);
     if (flags & time::status)
-        st_ctim = ::time::now();
+        update(st_ctim);
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ module system.bin.elf;
 import system.bin.exec;
 import system.scheduler;
 import system.memory;
+import system.vdso;
 import system.vfs;
 import boot;
 import lib;
@@ -99,7 +100,7 @@ namespace bin::elf::exec
 
                         lib::panic_if(!vmspace->map(
                             address, phdr.p_memsz + misalign,
-                            prot, vmm::flag::private_,
+                            prot, vmm::flag::private_ | vmm::flag::anonymous,
                             obj, 0
                         ));
 
@@ -188,7 +189,8 @@ namespace bin::elf::exec
             const auto stack_size = boot::ustack_size;
             const auto addr_bottom = thread->ustack_top - stack_size;
 
-            constexpr std::size_t num_auxvals = 6;
+            const auto vdso_base = vdso::map(*proc->vmspace);
+            const std::size_t num_auxvals = 6 + (vdso_base != 0);
 
             const bool one_more = (req.argv.size() + req.envp.size() + 1) & 1;
             const auto required_size =
@@ -265,6 +267,8 @@ namespace bin::elf::exec
             // write_auxv(AT_EXECFN, 0);
             // write_auxv(AT_RANDOM, 0);
             write_auxv(AT_SECURE, 0);
+            if (vdso_base != 0)
+                write_auxv(AT_SYSINFO_EHDR, vdso_base);
 
             offset -= 8;
             *sptr() = 0;
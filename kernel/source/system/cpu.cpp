@@ -174,6 +174,7 @@ namespace cpu
             };
             entry->extra_argument = reinterpret_cast<std::uint64_t>(&args);
             __atomic_store_n(&entry->goto_address, mp_entry, __ATOMIC_SEQ_CST);
+            arch::core::booting(cpu->idx);
 
             for (std::size_t i = 0; i < 100'000; i++)
             {
@@ -0,0 +1,168 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module system.hrtimer;
+
+import system.cpu.self;
+import system.cpu;
+import system.time;
+import arch;
+import lib;
+import cppstd;
+
+namespace hrtimer
+{
+    namespace arch
+    {
+        // false if there is no per-cpu timer interrupt
+        bool init();
+        // interrupt this cpu once the main clock reaches expires
+        void program(std::uint64_t expires);
+    } // namespace arch
+
+    namespace
+    {
+        struct by_expiry
+        {
+            bool operator()(const timer &lhs, const timer &rhs) const
+            {
+                return lhs.expires < rhs.expires;
+            }
+        };
+
+        struct percpu
+        {
+            lib::spinlock_irq lock;
+            lib::rbtree<timer, &timer::hook, by_expiry> queue;
+
+            // cancel() on other cpus waits for this to change
+            std::atomic<timer *> running = nullptr;
+            // what the hardware is set to fire at, 0 if nothing
+            std::uint64_t programmed = 0;
+
+            // timers queued without it never fire
+            bool ready = false;
+        };
+        cpu_local<percpu> local;
+        cpu_local_init(local);
+
+        percpu &nth(std::size_t idx)
+        {
+            return local.get(cpu::local::nth_base(idx));
+        }
+
+        // with base locked. true if timer was queued on it
+        bool dequeue(percpu &base, timer &timer, std::size_t idx)
+        {
+            if (timer.cpu.load(std::memory_order_relaxed) != idx)
+                return false;
+
+            base.queue.remove(&timer);
+            timer.cpu.store(no_cpu, std::memory_order_release);
+            return true;
+        }
+
+        // locks the base timer is queued on and removes it from there
+        bool remove(timer &timer)
+        {
+            while (true)
+            {
+                const auto idx = timer.cpu.load(std::memory_order_acquire);
+                if (idx == no_cpu)
+                    return false;
+
+                auto &base = nth(idx);
+                const std::unique_lock _ { base.lock };
+                // it might have fired or moved while we were taking the lock
+                if (dequeue(base, timer, idx))
+                    return true;
+            }
+        }
+
+        // with base locked
+        void reprogram(percpu &base)
+        {
+            const auto first = base.queue.first();
+            if (first == nullptr)
+            {
+                base.programmed = 0;
+                return;
+            }
+
+            if (!base.ready || (base.programmed != 0 && base.programmed <= first->expires))
+                return;
+
+            base.programmed = first->expires;
+            arch::program(first->expires);
+        }
+    } // namespace
+
+    void arm(timer &timer, std::uint64_t expires)
+    {
+        lib::bug_on(!timer.func);
+        remove(timer);
+
+        const auto idx = cpu::self()->idx;
+        auto &base = local.get();
+        const std::unique_lock _ { base.lock };
+        timer.expires = expires;
+        timer.cpu.store(idx, std::memory_order_release);
+        base.queue.insert(&timer);
+        reprogram(base);
+    }
+
+    bool cancel(timer &timer)
+    {
+        const bool ret = remove(timer);
+
+        // the callback itself may cancel its timer
+        const auto self = cpu::self();
+        for (std::size_t idx = 0; idx < cpu::count(); idx++)
+        {
+            if (self && idx == self->idx)
+                continue;
+            while (nth(idx).running.load(std::memory_order_acquire) == &timer)
+                ::arch::pause();
+        }
+        return ret;
+    }
+
+    std::optional<std::uint64_t> next_expiry()
+    {
+        auto &base = local.get();
+        const std::unique_lock _ { base.lock };
+        if (const auto first = base.queue.first())
+            return first->expires;
+        return std::nullopt;
+    }
+
+    void handle()
+    {
+        auto &base = local.get();
+        const auto clock = time::main_clock();
+
+        std::unique_lock guard { base.lock };
+        base.programmed = 0;
+
+        while (const auto first = base.queue.first())
+        {
+            if (first->expires > clock->ns())
+                break;
+
+            lib::bug_on(!dequeue(base, *first, cpu::self()->idx));
+            base.running.store(first, std::memory_order_release);
+
+            // func may re-arm or free its timer, don't touch it after this
+            guard.unlock();
+            first->func();
+            guard.lock();
+
+            base.running.store(nullptr, std::memory_order_release);
+        }
+        reprogram(base);
+    }
+
+    void init_cpu()
+    {
+        local->ready = arch::init();
+    }
+} // namespace hrtimer
@@ -0,0 +1,231 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module system.interrupts;
+
+import drivers.fs.procfs;
+import system.scheduler;
+import system.cpu.self;
+import system.cpu;
+import arch;
+import lib;
+import fmt;
+import cppstd;
+
+namespace interrupts
+{
+    namespace
+    {
+        struct threaded
+        {
+            std::function<irq_return (cpu::registers *)> quick;
+            std::function<void ()> handler;
+            std::size_t cpuidx;
+            std::size_t vector;
+            bool oneshot;
+            std::function<void (bool)> mask;
+
+            lib::spinlock lock;
+            std::size_t pending = 0;
+            sched::thread *thread = nullptr;
+        };
+
+        // never freed, the threads keep running
+        lib::locker<
+            std::vector<std::unique_ptr<threaded>>,
+            lib::mutex
+        > threads;
+
+        [[noreturn]] void irq_thread()
+        {
+            const auto me = sched::this_thread();
+
+            // threads don't take arguments, find our entry
+            threaded *irq = nullptr;
+            while (irq == nullptr)
+            {
+                {
+                    const auto locked = threads.lock();
+                    const auto it = std::ranges::find(*locked, me, [](const auto &entry) { return entry->thread; });
+                    if (it != locked->end())
+                        irq = it->get();
+                }
+                if (irq == nullptr)
+                    sched::yield();
+            }
+
+            while (true)
+            {
+                const bool ints = ::arch::int_switch_status(false);
+                irq->lock.lock();
+
+                const auto pending = std::exchange(irq->pending, 0);
+                if (pending == 0)
+                {
+                    // the interrupt wakes us only once we are off the cpu
+                    me->prepare_sleep();
+                    irq->lock.unlock();
+                    sched::yield();
+                    ::arch::int_switch(ints);
+                    continue;
+                }
+
+                irq->lock.unlock();
+                ::arch::int_switch(ints);
+
+                irq->handler();
+                if (irq->oneshot)
+                    irq->mask(false);
+            }
+        }
+    } // namespace
+
+    bool set_threaded(
+        std::size_t cpuidx, std::size_t vector,
+        std::function<irq_return (cpu::registers *)> quick,
+        std::function<void ()> handler, bool oneshot,
+        std::function<void (bool)> mask)
+    {
+        auto irq = get(cpuidx, vector);
+        if (!irq.has_value() || irq->get().used())
+            return false;
+
+        if (oneshot && !mask)
+        {
+            mask = [vector](bool masked) {
+                if (masked)
+                    interrupts::mask(vector);
+                else
+                    interrupts::unmask(vector);
+            };
+        }
+
+        auto ptr = std::make_unique<threaded>();
+        ptr->quick = std::move(quick);
+        ptr->handler = std::move(handler);
+        ptr->cpuidx = cpuidx;
+        ptr->vector = vector;
+        ptr->oneshot = oneshot;
+        ptr->mask = std::move(mask);
+
+        const auto raw = ptr.get();
+        {
+            auto locked = threads.lock();
+            raw->thread = sched::spawn_on(cpuidx, 0, reinterpret_cast<std::uintptr_t>(irq_thread), -10);
+            raw->thread->affinity = sched::cpumask { }.set(cpuidx);
+            locked->push_back(std::move(ptr));
+        }
+
+        irq->get().set([raw](cpu::registers *regs) {
+            if (raw->quick(regs) != irq_return::wake_thread)
+                return;
+
+            if (raw->oneshot)
+                raw->mask(true);
+
+            raw->lock.lock();
+            raw->pending++;
+            raw->lock.unlock();
+
+            raw->thread->wake_up(0);
+        });
+        return true;
+    }
+
+    bool set_affinity(std::size_t vector, std::size_t from, std::size_t to)
+    {
+        if (!route(vector, from, to))
+            return false;
+
+        sched::thread *thread = nullptr;
+        {
+            const auto locked = threads.lock();
+            const auto it = std::ranges::find_if(*locked, [vector, from](const auto &entry) {
+                return entry->vector == vector && entry->cpuidx == from;
+            });
+            if (it != locked->end())
+            {
+                (*it)->cpuidx = to;
+                thread = (*it)->thread;
+            }
+        }
+
+        if (thread != nullptr)
+            sched::set_affinity(thread, sched::cpumask { }.set(to));
+        return true;
+    }
+
+    lib::initgraph::task interrupts_task
+    {
+        "interrupts.stats.create",
+        lib::initgraph::postsched_init_engine,
+        lib::initgraph::require { fs::procfs::mounted_stage() },
+        [] {
+            const auto ret = fs::procfs::create("interrupts", [] {
+                std::string str { "      " };
+                for (std::size_t i = 0; i < cpu::count(); i++)
+                    fmt::format_to(std::back_inserter(str), " {:>10}", fmt::format("cpu{}", i));
+                str += '\n';
+
+                for (std::size_t vec = 0; vec < max_vectors; vec++)
+                {
+                    std::size_t total = 0;
+                    for (std::size_t i = 0; i < cpu::count(); i++)
+                        total += count(i, vec);
+                    if (total == 0)
+                        continue;
+
+                    fmt::format_to(std::back_inserter(str), "{:>5}:", vec);
+                    for (std::size_t i = 0; i < cpu::count(); i++)
+                        fmt::format_to(std::back_inserter(str), " {:>10}", count(i, vec));
+                    str += '\n';
+                }
+                return str;
+            });
+            lib::panic_if(!ret, "interrupts: could not create /proc/interrupts");
+
+            // "vector from to" moves vector, reading lists the cpus each vector is handled on
+            const auto affinity = fs::procfs::create("irq_affinity", [] {
+                std::string str;
+                for (std::size_t vec = 0; vec < max_vectors; vec++)
+                {
+                    std::string cpus;
+                    for (std::size_t i = 0; i < cpu::count(); i++)
+                    {
+                        const auto handler = get(i, vec);
+                        if (!handler.has_value() || !handler->get().used())
+                            continue;
+                        if (!cpus.empty())
+                            cpus += ',';
+                        fmt::format_to(std::back_inserter(cpus), "{}", i);
+                    }
+                    if (!cpus.empty())
+                        fmt::format_to(std::back_inserter(str), "{:>5}: {}\n", vec, cpus);
+                }
+                return str;
+            }, [](std::string_view str) {
+                const auto number = [&str] -> std::optional<std::size_t> {
+                    while (!str.empty() && str.front() == ' ')
+                        str.remove_prefix(1);
+
+                    std::size_t ret = 0, len = 0;
+                    for (; len < str.size() && str[len] >= '0' && str[len] <= '9'; len++)
+                        ret = ret * 10 + (str[len] - '0');
+                    str.remove_prefix(len);
+                    if (len == 0)
+                        return std::nullopt;
+                    return ret;
+                };
+
+                const auto vector = number();
+                const auto from = number();
+                const auto to = number();
+                if (!vector || !from || !to || !str.empty())
+                    return false;
+                if (vector.value() >= max_vectors || from.value() >= cpu::count() || to.value() >= cpu::count())
+                    return false;
+                return set_affinity(vector.value(), from.value(), to.value());
+            });
+            lib::panic_if(!affinity, "interrupts: could not create /proc/irq_affinity");
+        }
+    };
+} // namespace interrupts
@@ -42,31 +42,108 @@ namespace vmm
         return lib::tohh(ret);
     }
 
-    auto pagemap::getpte(std::uintptr_t vaddr, page_size psize, bool allocate) -> std::expected<std::reference_wrapper<entry>, error>
+    void pagemap::free_tables(table *ptr, std::size_t level)
     {
-        static constexpr std::uintptr_t bits = 0b111111111;
-        static constexpr std::size_t levels = 4;
-        static constexpr std::size_t shift_start = 12 + (levels - 1) * 9;
+        if (level != levels - 1)
+        {
+            for (auto &entry : ptr->entries)
+            {
+                if (classify(entry, level) == kind::table)
+                    free_tables(lib::tohh(reinterpret_cast<table *>(entry.access().getaddr())), level + 1);
+            }
+        }
+        free_table(lib::fromhh(ptr));
+    }
 
-        auto pml = lib::tohh(get_arch_table(vaddr));
+    std::size_t pagemap::walker::seek(std::uintptr_t vaddr, std::size_t target, bool allocate)
+    {
+        if (_depth != 0)
+        {
+            // the root can differ between halves of the address space
+            const auto diff = vaddr ^ _vaddr;
+            if (diff >> 63)
+                _depth = 0;
+            else
+            {
+                std::size_t depth = 1;
+                while (depth < _depth && (diff >> shift_for(depth - 1)) == 0)
+                    depth++;
+                _depth = depth;
+            }
+        }
+        _vaddr = vaddr;
 
-        const auto retidx = levels - static_cast<std::size_t>(psize) - 1;
-        auto shift = shift_start;
+        if (_depth == 0)
+        {
+            _tables[0] = lib::tohh(_pmap.get_arch_table(vaddr));
+            _depth = 1;
+        }
 
-        for (std::size_t i = 0; i < levels; i++)
+        auto level = _depth - 1;
+        while (level < target)
         {
-            auto &entry = pml->entries[(vaddr >> shift) & bits];
+            auto &entry = pte(level);
+            switch (classify(entry, level))
+            {
+                case kind::leaf:
+                    return level;
+                case kind::hole:
+                    if (!allocate)
+                        return level;
+                    [[fallthrough]];
+                case kind::table:
+                    _tables[level + 1] = getlvl(entry, allocate);
+                    break;
+            }
+            _depth = ++level + 1;
+        }
+        return target;
+    }
 
-            if (i == retidx)
-                return std::ref(entry);
+    void pagemap::walker::split(std::size_t level)
+    {
+        lib::bug_on(level == levels - 1);
+
+        auto &entry = pte(level);
+        const auto value = entry.access().value;
+
+        const auto span = span_for(level + 1);
+        const auto paddr = entry.access().getaddr() & ~(span_for(level) - 1);
+
+        const auto [flags, cache] = from_arch(value, psize_for(level));
+        const auto aflags = to_arch(flags, cache, psize_for(level + 1));
+
+        const auto ptr = new_table();
+        auto tbl = lib::tohh(ptr);
+        for (std::size_t i = 0; i < num_entries; i++)
+        {
+            tbl->entries[i].access()
+                .setaddr(paddr + i * span)
+                .setflags(aflags, true)
+                .write();
+        }
 
-            pml = getlvl(entry, allocate);
-            if (pml == nullptr)
-                return std::unexpected { error::invalid_entry };
+        entry.access().clear()
+            .setaddr(reinterpret_cast<std::uintptr_t>(ptr))
+            .setflags(new_table_flags, true)
+            .write();
+        invalidate(_vaddr);
 
-            shift -= 9;
+        _tables[level + 1] = tbl;
+        _depth = level + 2;
+    }
+
+    std::size_t pagemap::leaf_level_for(std::uintptr_t vaddr, std::uintptr_t paddr, std::size_t length, page_size min)
+    {
+        auto psize = fixpsize(page_size::large);
+        while (psize != min)
+        {
+            const auto size = from_page_size(psize);
+            if (vaddr % size == 0 && paddr % size == 0 && length >= size)
+                break;
+            psize = static_cast<page_size>(std::to_underlying(psize) - 1);
         }
-        std::unreachable();
+        return level_for(psize);
     }
 
     std::expected<void, error> pagemap::map(std::uintptr_t vaddr, std::uintptr_t paddr, std::size_t length, pflag flags, page_size psize, caching cache)
@@ -82,34 +159,46 @@ namespace vmm
 
         const std::unique_lock _ { _lock };
 
-        const auto aflags = to_arch(flags, cache, psize);
+        const auto end = vaddr + lib::align_up(length, npsize);
+        walker walk { *this };
 
-        for (std::size_t i = 0; i < length; i += npsize)
+        while (vaddr < end)
         {
-            const auto ret = getpte(vaddr + i, psize, true);
-            if (!ret.has_value())
+            auto level = leaf_level_for(vaddr, paddr, end - vaddr, psize);
+            if (const auto reached = walk.seek(vaddr, level, true); reached != level)
             {
-                // unmap
-                for (std::size_t ii = 0; ii < i; ii += npsize)
-                {
-                    const auto ret1 = getpte(vaddr + ii, psize, true);
-                    if (!ret1.has_value())
-                        return std::unexpected { ret1.error() };
-
-                    auto &pte = ret1->get();
-                    pte.access().clear().write();
-                    invalidate(vaddr + ii);
-                }
-                return std::unexpected { ret.error() };
+                // a larger leaf is in the way
+                walk.split(reached);
+                continue;
             }
-            else
+
+            // tables aren't freed here, other cpus may still walk them
+            // through their paging structure caches. map smaller leaves instead
+            while (level != levels - 1 && classify(walk.pte(level), level) == kind::table)
+                walk.seek(vaddr, ++level, true);
+
+            const auto span = span_for(level);
+            const auto aflags = to_arch(flags, cache, psize_for(level));
+
+            const auto tbl = walk.table_at(level);
+            for (auto idx = index_for(level, vaddr); idx < num_entries && end - vaddr >= span; idx++)
             {
-                auto &pte = ret->get();
+                auto &pte = tbl->entries[idx];
+                const auto type = classify(pte, level);
+                if (type == kind::table)
+                    break;
+
                 pte.access()
                     .clear()
-                    .setaddr(paddr + i)
+                    .setaddr(paddr)
                     .setflags(aflags, true)
                     .write();
+
+                if (type != kind::hole)
+                    invalidate(vaddr);
+
+                vaddr += span;
+                paddr += span;
             }
         }
 
@@ -121,51 +210,53 @@ namespace vmm
         lib::bug_on(!magic_enum::enum_contains(psize));
         lib::bug_on(!magic_enum::enum_contains(cache));
 
-        struct page { page *next = nullptr; };
-        page *current = nullptr;
-        page head { };
-
         psize = fixpsize(psize);
 
         const auto npsize = from_page_size(psize);
-        const auto npages = lib::div_roundup(npsize, pmm::page_size);
+        if (vaddr % npsize)
+            return std::unexpected { error::addr_not_aligned };
 
-        for (std::size_t i = 0; i < length; i += npsize)
-        {
-            const auto paddr = pmm::alloc<std::uintptr_t>(npages, false);
-            const auto pg = reinterpret_cast<page *>(lib::tohh(paddr));
+        const auto start = vaddr;
+        const auto end = vaddr + lib::align_up(length, npsize);
 
-            if (!head.next)
-            {
-                current = pg;
-                head.next = current;
-            }
-            else
+        const std::size_t min_pages = npsize / pmm::page_size;
+        std::size_t max_pages = lib::pow2(pmm::max_order);
+
+        while (vaddr < end)
+        {
+            // buddy blocks are naturally aligned, so keeping them aligned
+            // to vaddr too lets map use the largest leaves possible
+            const std::size_t left = (end - vaddr) / pmm::page_size;
+            const std::size_t align = lib::pow2(std::countr_zero(vaddr) - std::countr_zero(pmm::page_size));
+            auto npages = std::max(std::min({ lib::pre_pow2(left), align, max_pages }), min_pages);
+
+            std::uintptr_t paddr = 0;
+            while (npages > min_pages)
             {
-                current->next = pg;
-                current = current->next;
+                if ((paddr = pmm::try_alloc<std::uintptr_t>(npages, true)))
+                    break;
+                // don't retry orders that already failed
+                max_pages = (npages /= 2);
             }
+            if (paddr == 0)
+                paddr = pmm::alloc<std::uintptr_t>(npages, true);
 
-            if (const auto ret = map(vaddr + i, paddr, npsize, flags, psize, cache); !ret)
+            const auto size = npages * pmm::page_size;
+            if (const auto ret = map(vaddr, paddr, size, flags, psize, cache); !ret)
             {
-                current = head.next;
-                while (current)
-                {
-                    const auto next = current->next;
-                    pmm::free(current, npages);
-                    current = next;
-                }
+                pmm::free(paddr, npages);
+                if (vaddr != start)
+                    lib::unused(unmap_dealloc(start, vaddr - start, psize));
                 return std::unexpected { ret.error() };
             }
-        }
 
-        current = head.next;
-        while (current)
-        {
-            const auto next = current->next;
-            std::memset(current, 0, npages * pmm::page_size);
-            current = next;
+            // leaves can be split and partially unmapped later, so
+            // unmap_dealloc frees memory one page at a time
+            pmm::split(paddr, npages);
+
+            vaddr += size;
         }
+
         return { };
     }
 
@@ -181,26 +272,100 @@ namespace vmm
 
         const std::unique_lock _ { _lock };
 
-        const auto aflags = to_arch(flags, cache, psize);
+        const auto end = vaddr + lib::align_up(length, npsize);
+        walker walk { *this };
 
-        for (std::size_t i = 0; i < length; i += npsize)
+        while (vaddr < end)
         {
-            const auto ret = getpte(vaddr + i, psize, false);
-            if (ret.has_value())
+            const auto level = walk.seek(vaddr, levels - 1, false);
+            const auto span = span_for(level);
+            const auto tbl = walk.table_at(level);
+
+            std::uintptr_t aflags = 0;
+            for (auto idx = index_for(level, vaddr); idx < num_entries && vaddr < end; idx++)
             {
-                auto &pte = ret->get();
+                auto &pte = tbl->entries[idx];
+                const auto type = classify(pte, level);
+
+                // don't turn holes into present entries
+                if (type == kind::hole)
+                {
+                    vaddr = lib::align_down(vaddr, span) + span;
+                    continue;
+                }
+
+                if (type == kind::table)
+                    break;
+
+                if (vaddr % span || end - vaddr < span)
+                {
+                    walk.split(level);
+                    break;
+                }
+
+                if (aflags == 0)
+                    aflags = to_arch(flags, cache, psize_for(level));
+
+                const auto paddr = pte.access().getaddr() & ~(span - 1);
                 pte.access()
-                    .clearflags()
+                    .clear()
+                    .setaddr(paddr)
                     .setflags(aflags, true)
                     .write();
-                invalidate(vaddr + i);
+                invalidate(vaddr);
+
+                vaddr += span;
             }
-            else return std::unexpected { ret.error() };
         }
 
         return { };
     }
 
+    void pagemap::clear_range(std::uintptr_t vaddr, std::uintptr_t end, bool dealloc)
+    {
+        walker walk { *this };
+
+        while (vaddr < end)
+        {
+            const auto level = walk.seek(vaddr, levels - 1, false);
+            const auto span = span_for(level);
+            const auto tbl = walk.table_at(level);
+
+            for (auto idx = index_for(level, vaddr); idx < num_entries && vaddr < end; idx++)
+            {
+                auto &pte = tbl->entries[idx];
+                const auto type = classify(pte, level);
+
+                if (type == kind::hole)
+                {
+                    vaddr = lib::align_down(vaddr, span) + span;
+                    continue;
+                }
+
+                if (type == kind::table)
+                    break;
+
+                if (vaddr % span || end - vaddr < span)
+                {
+                    walk.split(level);
+                    break;
+                }
+
+                const auto paddr = pte.access().getaddr() & ~(span - 1);
+                pte.access().clear().write();
+                invalidate(vaddr);
+
+                if (dealloc)
+                {
+                    for (std::size_t off = 0; off < span; off += pmm::page_size)
+                        pmm::free(paddr + off);
+                }
+
+                vaddr += span;
+            }
+        }
+    }
+
     std::expected<void, error> pagemap::unmap(std::uintptr_t vaddr, std::size_t length, page_size psize)
     {
         lib::bug_on(!magic_enum::enum_contains(psize));
@@ -212,20 +377,8 @@ namespace vmm
         if (vaddr % npsize)
             return std::unexpected { error::addr_not_aligned };
 
-        for (std::size_t i = 0; i < length; i += npsize)
-        {
-            const auto ret = getpte(vaddr + i, psize, false);
-
-            // if there's a hole that's not mapped, don't throw an error
-            if (!ret.has_value())
-                continue;
-                // return std::unexpected { ret.error() };
-
-            auto &pte = ret->get();
-            pte.access().clear().write();
-            invalidate(vaddr + i);
-        }
-
+        // if there's a hole that's not mapped, don't throw an error
+        clear_range(vaddr, vaddr + lib::align_up(length, npsize), false);
         return { };
     }
 
@@ -233,20 +386,73 @@ namespace vmm
     {
         lib::bug_on(!magic_enum::enum_contains(psize));
 
+        const std::unique_lock _ { _lock };
+
         psize = fixpsize(psize);
         const auto npsize = from_page_size(psize);
+        if (vaddr % npsize)
+            return std::unexpected { error::addr_not_aligned };
+
+        clear_range(vaddr, vaddr + lib::align_up(length, npsize), true);
+        return { };
+    }
+
+    std::expected<void, error> pagemap::move(std::uintptr_t from, std::uintptr_t to, std::size_t length)
+    {
+        const auto npsize = from_page_size(page_size::small);
+        if (from % npsize || to % npsize)
+            return std::unexpected { error::addr_not_aligned };
+
+        length = lib::align_up(length, npsize);
+        if (lib::range_overlaps(from, from + length, to, to + length))
+            return std::unexpected { error::addr_in_use };
 
-        for (std::size_t i = 0; i < length; i += npsize)
+        const std::unique_lock _ { _lock };
+
+        constexpr auto last = levels - 1;
+        const auto end = from + length;
+
+        walker src { *this };
+        walker dst { *this };
+
+        while (from < end)
         {
-            const auto rett = translate(vaddr + i, psize);
-            if (!rett)
-                return std::unexpected { rett.error() };
+            if (const auto level = src.seek(from, last, false); level != last)
+            {
+                if (classify(src.pte(level), level) == kind::leaf)
+                {
+                    // the destination might not be aligned the same way
+                    src.split(level);
+                    continue;
+                }
 
-            const auto retu = unmap(vaddr + i, npsize, psize);
-            if (!retu)
-                return std::unexpected { retu.error() };
+                const auto skip = std::min(lib::align_down(from, span_for(level)) + span_for(level), end) - from;
+                from += skip;
+                to += skip;
+                continue;
+            }
+
+            auto &pte = src.pte(last);
+            if (const auto value = pte.access().value; value != 0)
+            {
+                pte.access().clear().write();
+                invalidate(from);
+
+                std::size_t level;
+                while ((level = dst.seek(to, last, true)) != last)
+                    dst.split(level);
+
+                auto accessor = dst.pte(last).access();
+                const bool was_mapped = accessor.value != 0;
+                accessor.value = value;
+                accessor.write();
+
+                if (was_mapped)
+                    invalidate(to);
+            }
 
-            pmm::free(rett.value());
+            from += npsize;
+            to += npsize;
         }
 
         return { };
@@ -262,11 +468,15 @@ namespace vmm
         if (vaddr % from_page_size(psize))
             return std::unexpected { error::addr_not_aligned };
 
-        const auto ret = getpte(vaddr, psize, false);
-        if (!ret.has_value())
-            return std::unexpected { ret.error() };
+        walker walk { *this };
+        const auto level = walk.seek(vaddr, levels - 1, false);
 
-        const auto addr = ret->get().access().getaddr();
+        auto &pte = walk.pte(level);
+        if (classify(pte, level) != kind::leaf)
+            return std::unexpected { error::not_mapped };
+
+        const auto span = span_for(level);
+        const auto addr = (pte.access().getaddr() & ~(span - 1)) + (vaddr & (span - 1));
         if (!is_canonical(addr))
             return std::unexpected { error::invalid_entry };
 
@@ -277,21 +487,18 @@ namespace vmm
     {
         log::warn("vmm: destroying a pagemap");
 
-        [](this auto self, table *ptr, std::size_t start, std::size_t end, std::size_t level)
-        {
-            if (level == 0)
-                return;
-
-            for (std::size_t i = start; i < end; i++)
-            {
-                auto lvl = getlvl(ptr->entries[i], false);
-                if (lvl == nullptr)
-                    continue;
+        // every cpu loaded another pagemap when it switched away from this
+        // one's process, which flushed its paging structure caches
 
-                self(lvl, 0, 512, level - 1);
-            }
-            free_table(lib::fromhh(ptr));
-        } (lib::tohh(_table), 0, 256, 4);
+        // only the lower half belongs to this pagemap
+        auto root = lib::tohh(_table);
+        for (std::size_t i = 0; i < num_entries / 2; i++)
+        {
+            auto &entry = root->entries[i];
+            if (classify(entry, 0) == kind::table)
+                free_tables(lib::tohh(reinterpret_cast<table *>(entry.access().getaddr())), 1);
+        }
+        free_table(_table);
     }
 
     void init()
@@ -386,12 +593,11 @@ namespace vmm
     void init_vspaces()
     {
         vspace_base = lib::tohh(lib::align_up(pmm::info().free_start(), lib::gib(1)));
+        init_zero_page();
     }
 
     std::uintptr_t alloc_vspace(std::size_t pages)
     {
-        const auto ret = vspace_base;
-        vspace_base += pages * pmm::page_size;
-        return ret;
+        return std::atomic_ref { vspace_base }.fetch_add(pages * pmm::page_size);
     }
 } // namespace vmm
\ No newline at end of file
@@ -15,7 +15,7 @@ namespace pmm
 {
     namespace
     {
-        constinit lib::spinlock_irq lock;
+        constinit lib::queued_spinlock_irq lock;
         constinit memory mem;
         constinit bool initialised = false;
 
@@ -433,7 +433,7 @@ namespace pmm
     }
 
     [[nodiscard]]
-    void *alloc(std::size_t npages, bool clear, type tp)
+    void *try_alloc(std::size_t npages, bool clear, type tp)
     {
         if (npages == 0)
             return nullptr;
@@ -467,15 +467,11 @@ namespace pmm
                     lib::panic("pmm: unknown allocation type {}", magic_enum::enum_name(tp));
             }
         }
-        else ret = { bootstrap_alloc(npages), size };
+        else if (npages == 1)
+            ret = { bootstrap_alloc(npages), size };
 
         if (!ret.first)
-        {
-            lib::panic(
-                "pmm: could not allocate {} page{}. type: {}",
-                npages, npages == 1 ? "" : "s", magic_enum::enum_name(tp)
-            );
-        }
+            return nullptr;
 
         if (clear)
             std::memset(ret.first, 0, size);
@@ -484,6 +480,59 @@ namespace pmm
         return lib::fromhh(ret.first);
     }
 
+    [[nodiscard]]
+    void *alloc(std::size_t npages, bool clear, type tp)
+    {
+        if (npages == 0)
+            return nullptr;
+
+        if (const auto ret = try_alloc(npages, clear, tp))
+            return ret;
+
+        lib::panic(
+            "pmm: could not allocate {} page{}. type: {}",
+            npages, npages == 1 ? "" : "s", magic_enum::enum_name(tp)
+        );
+    }
+
+    void split(void *ptr, std::size_t npages, std::size_t chunk)
+    {
+        const auto order = lib::log2(lib::next_pow2(npages));
+        const auto target = lib::log2(lib::next_pow2(chunk));
+        lib::bug_on(target > order);
+
+        if (target == order)
+            return;
+
+        const std::unique_lock _ { lock };
+
+        const auto base = lib::tohh(reinterpret_cast<std::uintptr_t>(ptr));
+        const auto end = base + page_size * lib::pow2(order);
+
+        lib::bug_on(page_for(base)->allocated == 0);
+        lib::bug_on(page_for(base)->order != order);
+
+        // same buddy chaining as split_to, but the halves stay allocated
+        for (auto current = order; current > target; current--)
+        {
+            const auto size = page_size * lib::pow2(current);
+            for (auto addr = base; addr < end; addr += size)
+            {
+                const auto buddy = addr + size / 2;
+
+                const auto pg_page = page_for(addr);
+                const auto buddy_page = page_for(buddy);
+
+                buddy_page->order = current - 1;
+                buddy_page->allocated = 1;
+                buddy_page->next_paddr = pg_page->next_paddr;
+
+                pg_page->order = current - 1;
+                pg_page->next_paddr = lib::fromhh(buddy) >> page_bits;
+            }
+        }
+    }
+
     void free(void *ptr, std::size_t npages)
     {
         if (npages == 0 || ptr == nullptr)
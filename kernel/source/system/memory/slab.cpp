@@ -39,8 +39,8 @@ namespace slab
     };
 
     constinit policy valloc;
-    constinit frg::manual_box<frg::slab_pool<policy, lib::spinlock>> pool;
-    constinit frg::manual_box<frg::slab_allocator<policy, lib::spinlock>> kalloc;
+    constinit frg::manual_box<frg::slab_pool<policy, lib::queued_spinlock>> pool;
+    constinit frg::manual_box<frg::slab_allocator<policy, lib::queued_spinlock>> kalloc;
 
     void *alloc(std::size_t size)
     {
@@ -12,6 +12,72 @@ import :pagemap;
 
 namespace vmm
 {
+    namespace
+    {
+        constinit std::uintptr_t zpage = 0;
+
+        pflag to_pflags(std::uint8_t prot)
+        {
+            auto ret = pflag::user;
+            if (prot & prot::read)
+                ret |= pflag::read;
+            if (prot & prot::write)
+                ret |= pflag::write;
+            if (prot & prot::exec)
+                ret |= pflag::exec;
+            return ret;
+        }
+
+        // pages read ahead after a fault in a sequentially accessed mapping
+        constexpr std::size_t readahead_pages = 16;
+
+        // lowest address handed out when the caller doesn't pick one. keeps
+        // page 0 and everything near it unmapped
+        constexpr std::uintptr_t min_free_address = 0x10000;
+
+        std::optional<std::uintptr_t> find_free(const lib::btree::multiset<mapping> &tree, std::size_t pages, std::uintptr_t minp)
+        {
+            const auto psize = default_page_size();
+
+            std::uintptr_t last_endp = std::max(minp, min_free_address / psize);
+            for (const auto &entry : tree)
+            {
+                if (entry.startp >= last_endp && entry.startp - last_endp >= pages)
+                    return last_endp * psize;
+                last_endp = std::max(last_endp, entry.endp);
+            }
+
+            const auto start = last_endp * psize;
+            const auto end = (last_endp + pages) * psize;
+            if (end <= start || !pagemap::is_canonical(start) || !pagemap::is_canonical(end - 1))
+                return std::nullopt;
+            return start;
+        }
+
+        // zero page ptes are read-only and must never become writable
+        void drop_zero_pages(pagemap &pmap, std::uintptr_t vaddr, std::size_t length)
+        {
+            const auto psize = default_page_size();
+            for (std::size_t i = 0; i < length; i += psize)
+            {
+                const auto ret = pmap.translate(vaddr + i, page_size::small);
+                if (ret.has_value() && ret.value() == zpage)
+                    lib::panic_if(!pmap.unmap(vaddr + i, psize, page_size::small), "vmm: could not unmap the zero page");
+            }
+        }
+    } // namespace
+
+    void init_zero_page()
+    {
+        zpage = pmm::alloc<std::uintptr_t>(1, true);
+    }
+
+    std::uintptr_t zero_page()
+    {
+        lib::bug_on(zpage == 0);
+        return zpage;
+    }
+
     std::size_t default_page_size()
     {
         return pagemap::from_page_size(page_size::small);
@@ -31,6 +97,52 @@ namespace vmm
         return 0;
     }
 
+    std::uintptr_t object::peek_page(std::size_t idx)
+    {
+        const auto locked = pages.lock();
+        if (const auto page = locked->find(idx); page != locked->end())
+            return page->second;
+        return 0;
+    }
+
+    bool object::has_pages(std::size_t idx, std::size_t count)
+    {
+        const auto locked = pages.lock();
+        const auto page = locked->lower_bound(idx);
+        return page != locked->end() && page->first < idx + count;
+    }
+
+    std::uintptr_t object::contiguous(std::size_t idx, std::size_t count)
+    {
+        const auto psize = default_page_size();
+        const auto locked = pages.lock();
+
+        auto page = locked->find(idx);
+        if (page == locked->end())
+            return 0;
+
+        const auto base = page->second;
+        for (std::size_t i = 0; i < count; i++, page++)
+        {
+            if (page == locked->end() || page->first != idx + i || page->second != base + i * psize)
+                return 0;
+        }
+        return base;
+    }
+
+    bool object::adopt_pages(std::size_t idx, std::uintptr_t paddr, std::size_t count)
+    {
+        const auto psize = default_page_size();
+
+        auto locked = pages.lock();
+        if (const auto page = locked->lower_bound(idx); page != locked->end() && page->first < idx + count)
+            return false;
+
+        for (std::size_t i = 0; i < count; i++)
+            locked->insert({ idx + i, paddr + i * psize });
+        return true;
+    }
+
     std::size_t object::read(std::uint64_t offset, std::span<std::byte> buffer)
     {
         const auto psize = default_page_size();
@@ -111,6 +223,9 @@ namespace vmm
     {
         const auto psize = default_page_size();
 
+        // holes in the source don't need to be committed if they're holes in the target too
+        const bool sparse = is_zero_filled() && other.is_zero_filled();
+
         std::size_t progress = 0;
         while (progress < length)
         {
@@ -118,9 +233,14 @@ namespace vmm
             const auto idx = (progress + offset) / psize;
             const auto csize = std::min(psize - misalign, length - progress);
 
-            const auto our_page = get_page(idx);
+            const auto our_page = sparse ? peek_page(idx) : get_page(idx);
             if (our_page == 0)
-                break;
+            {
+                if (!sparse)
+                    break;
+                progress += csize;
+                continue;
+            }
 
             const auto their_page = other.get_page(idx);
             if (their_page == 0)
@@ -144,6 +264,19 @@ namespace vmm
 
     void memobject::write_back() { }
 
+    bool memobject::discard(std::size_t idx, std::size_t count)
+    {
+        auto locked = pages.lock();
+
+        auto page = locked->lower_bound(idx);
+        while (page != locked->end() && page->first < idx + count)
+        {
+            pmm::free(page->second);
+            page = locked->erase(page);
+        }
+        return true;
+    }
+
     memobject::~memobject()
     {
         for (const auto &[idx, page] : *pages.lock())
@@ -153,7 +286,20 @@ namespace vmm
     std::expected<void, error> vmspace::map(
             std::uintptr_t address, std::size_t length,
             std::uint8_t prot, std::uint8_t flags,
-            std::shared_ptr<object> obj, off_t offset
+            std::shared_ptr<object> obj, off_t offset,
+            std::uint8_t hints
+        )
+    {
+        const auto locked = tree.write_lock();
+        return map_locked(*locked, address, length, prot, flags, std::move(obj), offset, hints);
+    }
+
+    std::expected<void, error> vmspace::map_locked(
+            lib::btree::multiset<mapping> &mappings,
+            std::uintptr_t address, std::size_t length,
+            std::uint8_t prot, std::uint8_t flags,
+            std::shared_ptr<object> obj, off_t offset,
+            std::uint8_t hints
         )
     {
         lib::bug_on(obj == nullptr);
@@ -170,10 +316,8 @@ namespace vmm
         const auto startp = address / psize;
         const auto endp = lib::div_roundup(address + length, psize);
 
-        const auto locked = tree.write_lock();
-
         const auto overlapping = std::ranges::to<std::vector<mapping>>(
-            std::views::filter(*locked, [startp, endp](const auto &entry) {
+            std::views::filter(mappings, [startp, endp](const auto &entry) {
                 return startp < entry.endp && entry.startp < endp;
             })
         );
@@ -183,7 +327,7 @@ namespace vmm
             if (entry.flags & flag::untouchable)
                 return std::unexpected { error::addr_in_use };
 
-            locked->erase(entry);
+            mappings.erase(entry);
 
             if (startp <= entry.startp && entry.endp <= endp)
             {
@@ -202,27 +346,27 @@ namespace vmm
 
                 if (headp != 0)
                 {
-                    locked->emplace(
+                    mappings.emplace(
                         entry.startp, entry.startp + headp,
                         entry.obj, entry.offsetp,
-                        entry.prot, entry.flags
+                        entry.prot, entry.flags, entry.hints
                     );
                 }
                 if (endp != 0)
                 {
-                    locked->emplace(
+                    mappings.emplace(
                         entry.endp - tailp, entry.endp,
                         entry.obj, entry.offsetp + headp + (endp - startp),
-                        entry.prot, entry.flags
+                        entry.prot, entry.flags, entry.hints
                     );
                 }
             }
         };
 
-        locked->emplace(
+        mappings.emplace(
             startp, endp,
             obj, offsetp,
-            prot, flags
+            prot, flags, hints
         );
 
         return { };
@@ -245,6 +389,9 @@ namespace vmm
             })
         );
 
+        if ((prot & prot::write) && std::ranges::any_of(overlapping, [](const auto &entry) { return entry.flags & flag::no_write; }))
+            return std::unexpected { error::not_permitted };
+
         for (const auto &entry : overlapping)
         {
             locked->erase(entry);
@@ -265,7 +412,7 @@ namespace vmm
                 locked->emplace(
                     entry.startp, entry.startp + headp,
                     entry.obj, entry.offsetp,
-                    entry.prot, entry.flags
+                    entry.prot, entry.flags, entry.hints
                 );
             }
 
@@ -274,7 +421,7 @@ namespace vmm
                 locked->emplace(
                     entry.endp - tailp, entry.endp,
                     entry.obj, entry.offsetp + (entry.endp - entry.startp) - tailp,
-                    entry.prot, entry.flags
+                    entry.prot, entry.flags, entry.hints
                 );
             }
 
@@ -317,16 +464,7 @@ namespace vmm
         if (address % psize)
             return std::unexpected { error::addr_not_aligned };
 
-        const auto pflags = [prot] {
-            auto ret = pflag::user;
-            if (prot & prot::read)
-                ret |= pflag::read;
-            if (prot & prot::write)
-                ret |= pflag::write;
-            if (prot & prot::exec)
-                ret |= pflag::exec;
-            return ret;
-        } ();
+        const auto pflags = to_pflags(prot);
 
         const auto pages = lib::div_roundup(length, psize);
         const auto startp = address / psize;
@@ -349,11 +487,13 @@ namespace vmm
                 locked->emplace(
                     entry.startp, entry.endp,
                     entry.obj, entry.offsetp,
-                    prot, entry.flags
+                    prot, entry.flags, entry.hints
                 );
 
                 const auto addr = entry.startp * psize;
                 const auto sz = (entry.endp - entry.startp) * psize;
+                if (prot & prot::write)
+                    drop_zero_pages(*pmap, addr, sz);
                 lib::panic_if(!pmap->protect(addr, sz, pflags), "vmm: could not change protection flags");
 
                 continue;
@@ -367,7 +507,7 @@ namespace vmm
                 locked->emplace(
                     entry.startp, entry.startp + headp,
                     entry.obj, entry.offsetp,
-                    entry.prot, entry.flags
+                    entry.prot, entry.flags, entry.hints
                 );
             }
 
@@ -376,18 +516,20 @@ namespace vmm
                 locked->emplace(
                     entry.endp - tailp, entry.endp,
                     entry.obj, entry.offsetp + (entry.endp - entry.startp) - tailp,
-                    entry.prot, entry.flags
+                    entry.prot, entry.flags, entry.hints
                 );
             }
 
             locked->emplace(
                 std::max(startp, entry.startp), std::min(endp, entry.endp),
                 entry.obj, entry.offsetp + headp,
-                prot, entry.flags
+                prot, entry.flags, entry.hints
             );
 
             const auto addr = std::max(startp, entry.startp) * psize;
             const auto sz = std::min(endp, entry.endp) * psize - addr;
+            if (prot & prot::write)
+                drop_zero_pages(*pmap, addr, sz);
             lib::panic_if(!pmap->protect(addr, sz, pflags), "vmm: could not change protection flags");
         };
 
@@ -427,48 +569,354 @@ namespace vmm
         return covered >= endp;
     }
 
-    std::uintptr_t vmspace::find_free_region(std::size_t length)
+    std::uintptr_t vmspace::find_free_region(std::size_t length, std::uintptr_t above)
     {
         const auto psize = default_page_size();
-
         const auto pages = lib::div_roundup(length, psize);
         const auto locked = tree.read_lock();
+        return find_free(*locked, pages, lib::div_roundup(above, psize)).value_or(0);
+    }
+
+    std::expected<std::uintptr_t, error> vmspace::remap(
+            std::uintptr_t old_address, std::size_t old_length,
+            std::size_t new_length, bool may_move, std::uintptr_t new_address
+        )
+    {
+        const auto psize = default_page_size();
+        if (old_address % psize || new_address % psize)
+            return std::unexpected { error::addr_not_aligned };
+
+        const auto old_pages = lib::div_roundup(old_length, psize);
+        const auto new_pages = lib::div_roundup(new_length, psize);
+
+        const bool fixed = new_address != 0;
+        if (fixed)
+        {
+            if (lib::range_overlaps(old_address, old_address + old_pages * psize, new_address, new_address + new_pages * psize))
+                return std::unexpected { error::addr_in_use };
+
+            if (const auto ret = unmap(new_address, new_pages * psize); !ret)
+                return std::unexpected { ret.error() };
+        }
+        else if (new_pages <= old_pages)
+        {
+            if (new_pages != old_pages)
+            {
+                if (const auto ret = unmap(old_address + new_pages * psize, (old_pages - new_pages) * psize); !ret)
+                    return std::unexpected { ret.error() };
+            }
+            return old_address;
+        }
+
+        const auto oldp = old_address / psize;
+        const auto old_endp = oldp + old_pages;
+
+        const auto locked = tree.write_lock();
 
-        // TODO: set cap
+        const auto it = std::ranges::find_if(*locked, [oldp, old_endp](const auto &entry) {
+            return entry.startp <= oldp && old_endp <= entry.endp;
+        });
+        if (it == locked->end())
+            return std::unexpected { error::not_mapped };
+
+        const auto entry = *it;
+        if (entry.flags & flag::untouchable)
+            return std::unexpected { error::addr_in_use };
+
+        const auto is_free = [&locked](std::uintptr_t startp, std::uintptr_t endp) {
+            return std::ranges::none_of(*locked, [startp, endp](const auto &other) {
+                return startp < other.endp && other.startp < endp;
+            });
+        };
 
-        std::uintptr_t last_endp = 0;
-        for (const auto &entry : *locked)
+        // grow in place
+        if (!fixed && entry.endp == old_endp && is_free(old_endp, oldp + new_pages))
         {
-            if (entry.startp - last_endp >= pages)
-                return last_endp * psize;
-            last_endp = entry.endp;
+            locked->erase(entry);
+            locked->emplace(
+                entry.startp, oldp + new_pages,
+                entry.obj, entry.offsetp,
+                entry.prot, entry.flags, entry.hints
+            );
+            return old_address;
         }
 
-        return last_endp * psize;
+        if (!may_move)
+            return std::unexpected { error::addr_in_use };
+
+        auto target = new_address;
+        if (!fixed)
+        {
+            const auto free = find_free(*locked, new_pages, 0);
+            if (!free.has_value())
+                return std::unexpected { error::addr_in_use };
+            target = free.value();
+        }
+
+        const auto newp = target / psize;
+
+        locked->erase(entry);
+
+        const auto headp = oldp - entry.startp;
+        const auto tailp = entry.endp - old_endp;
+
+        if (headp != 0)
+        {
+            locked->emplace(
+                entry.startp, oldp,
+                entry.obj, entry.offsetp,
+                entry.prot, entry.flags, entry.hints
+            );
+        }
+
+        if (tailp != 0)
+        {
+            locked->emplace(
+                old_endp, entry.endp,
+                entry.obj, entry.offsetp + headp + old_pages,
+                entry.prot, entry.flags, entry.hints
+            );
+        }
+
+        locked->emplace(
+            newp, newp + new_pages,
+            entry.obj, entry.offsetp + headp,
+            entry.prot, entry.flags, entry.hints
+        );
+
+        // the pages stay where they are, only the ptes pointing to them move
+        const auto moved = std::min(old_pages, new_pages) * psize;
+        lib::panic_if(!pmap->move(old_address, target, moved), "vmm: could not move page table entries");
+        if (old_pages > new_pages)
+            lib::panic_if(!pmap->unmap(old_address + moved, old_pages * psize - moved), "vmm: could not unmap region");
+
+        return target;
     }
 
-    bool handle_pfault(std::uintptr_t addr, bool on_write)
+    std::expected<void, error> vmspace::set_hints(std::uintptr_t address, std::size_t length, std::uint8_t set, std::uint8_t clear)
     {
         const auto psize = default_page_size();
-        const auto proc = sched::this_thread()->parent;
-        const auto &vmspace = proc->vmspace;
+        if (address % psize)
+            return std::unexpected { error::addr_not_aligned };
+
+        const auto startp = address / psize;
+        const auto endp = startp + lib::div_roundup(length, psize);
+
+        const auto locked = tree.write_lock();
+
+        const auto overlapping = std::ranges::to<std::vector<mapping>>(
+            std::views::filter(*locked, [startp, endp](const auto &entry) {
+                return startp < entry.endp && entry.startp < endp && !(entry.flags & flag::untouchable);
+            })
+        );
+
+        for (const auto &entry : overlapping)
+        {
+            locked->erase(entry);
+
+            const auto headp = startp > entry.startp ? startp - entry.startp : 0;
+            const auto tailp = endp < entry.endp ? entry.endp - endp : 0;
+
+            if (headp != 0)
+            {
+                locked->emplace(
+                    entry.startp, entry.startp + headp,
+                    entry.obj, entry.offsetp,
+                    entry.prot, entry.flags, entry.hints
+                );
+            }
+
+            if (tailp != 0)
+            {
+                locked->emplace(
+                    entry.endp - tailp, entry.endp,
+                    entry.obj, entry.offsetp + (entry.endp - entry.startp) - tailp,
+                    entry.prot, entry.flags, entry.hints
+                );
+            }
+
+            locked->emplace(
+                std::max(startp, entry.startp), std::min(endp, entry.endp),
+                entry.obj, entry.offsetp + headp,
+                entry.prot, entry.flags,
+                static_cast<std::uint8_t>((entry.hints | set) & ~clear)
+            );
+        }
+
+        return { };
+    }
+
+    std::expected<void, error> vmspace::set_hints(std::uint8_t set, std::uint8_t clear)
+    {
+        const auto locked = tree.write_lock();
+
+        const auto entries = std::ranges::to<std::vector<mapping>>(
+            std::views::filter(*locked, [](const auto &entry) {
+                return !(entry.flags & flag::untouchable);
+            })
+        );
+
+        for (const auto &entry : entries)
+        {
+            locked->erase(entry);
+            locked->emplace(
+                entry.startp, entry.endp,
+                entry.obj, entry.offsetp,
+                entry.prot, entry.flags,
+                static_cast<std::uint8_t>((entry.hints | set) & ~clear)
+            );
+        }
+
+        return { };
+    }
+
+    std::expected<void, error> vmspace::discard(std::uintptr_t address, std::size_t length)
+    {
+        const auto psize = default_page_size();
+        if (address % psize)
+            return std::unexpected { error::addr_not_aligned };
+
+        const auto startp = address / psize;
+        const auto endp = startp + lib::div_roundup(length, psize);
+
+        const auto locked = tree.write_lock();
+
+        const auto overlaps = [startp, endp](const auto &entry) {
+            return startp < entry.endp && entry.startp < endp && !(entry.flags & flag::untouchable);
+        };
+
+        for (const auto &entry : std::views::filter(*locked, overlaps))
+        {
+            if (entry.hints & hint::mlocked)
+                return std::unexpected { error::addr_locked };
+        }
+
+        for (const auto &entry : std::views::filter(*locked, overlaps))
+        {
+            const auto sp = std::max(startp, entry.startp);
+            const auto ep = std::min(endp, entry.endp);
+            lib::panic_if(!pmap->unmap(sp * psize, (ep - sp) * psize), "vmm: could not unmap region");
+
+            // shared and file backed contents must survive, they are just faulted in again
+            if (!(entry.flags & flag::private_) || !entry.obj->is_zero_filled())
+                continue;
+
+            // the object may still be shared with another address space after fork
+            const auto refs = std::ranges::count_if(*locked, [&entry](const auto &other) {
+                return other.obj == entry.obj;
+            });
+            if (entry.obj.use_count() != refs)
+                continue;
 
+            entry.obj->discard(entry.offsetp + (sp - entry.startp), ep - sp);
+        }
+
+        return { };
+    }
+
+    std::expected<void, error> vmspace::prefetch(std::uintptr_t address, std::size_t length)
+    {
+        const auto psize = default_page_size();
+        if (address % psize)
+            return std::unexpected { error::addr_not_aligned };
+
+        const auto startp = address / psize;
+        const auto endp = startp + lib::div_roundup(length, psize);
+
+        const auto locked = tree.read_lock();
+
+        auto overlapping = std::views::filter(*locked, [startp, endp](const auto &entry) {
+            return startp < entry.endp && entry.startp < endp;
+        });
+
+        for (const auto &entry : overlapping)
+        {
+            // reading ahead zero-filled memory would only commit it
+            if (entry.obj->is_zero_filled())
+                continue;
+
+            const auto sp = std::max(startp, entry.startp);
+            const auto ep = std::min(endp, entry.endp);
+            for (auto page = sp; page < ep; page++)
+            {
+                if (entry.obj->get_page(entry.offsetp + (page - entry.startp)) == 0)
+                    break;
+            }
+        }
+
+        return { };
+    }
+
+    std::expected<void, error> vmspace::populate(std::uintptr_t address, std::size_t length)
+    {
+        const auto psize = default_page_size();
+        if (address % psize)
+            return std::unexpected { error::addr_not_aligned };
+
+        const auto startp = address / psize;
+        const auto endp = startp + lib::div_roundup(length, psize);
+
+        struct range
+        {
+            std::uintptr_t startp;
+            std::uintptr_t endp;
+            bool write;
+        };
+
+        std::vector<range> ranges;
+        {
+            const auto locked = tree.read_lock();
+            for (const auto &entry : *locked)
+            {
+                if (!(startp < entry.endp && entry.startp < endp) || entry.prot == prot::none)
+                    continue;
+
+                ranges.emplace_back(
+                    std::max(startp, entry.startp), std::min(endp, entry.endp),
+                    (entry.prot & prot::write) != 0
+                );
+            }
+        }
+
+        for (const auto &range : ranges)
+        {
+            for (auto page = range.startp; page < range.endp; page++)
+            {
+                const auto vaddr = page * psize;
+                if (const auto ret = pmap->translate(vaddr); ret.has_value() && !(range.write && ret.value() == zero_page()))
+                    continue;
+
+                if (!fault(vaddr, range.write))
+                    return std::unexpected { error::not_mapped };
+            }
+        }
+
+        return { };
+    }
+
+    bool vmspace::fault(std::uintptr_t addr, bool on_write)
+    {
+        const auto psize = default_page_size();
         const auto page = addr / psize;
 
         std::shared_ptr<object> obj { };
         std::size_t pidx = 0;
         auto pflags = pflag::none;
+        bool may_share_zero = false;
+        std::uint8_t hints = 0;
+        std::uintptr_t startp = 0, endp = 0;
         {
-            const auto wlocked = vmspace->tree.write_lock();
+            const auto wlocked = tree.write_lock();
             const auto it = std::ranges::find_if(*wlocked, [page](const auto &entry) {
                 return entry.startp <= page && page < entry.endp;
             });
 
             if (it != wlocked->end())
             {
-                auto &entry = *it;
+                const bool cow = on_write && (it->flags & flag::private_) && it->obj.use_count() > 1;
+                const auto entry = *it;
 
-                if (on_write && (entry.flags & flag::private_) && entry.obj.use_count() > 1)
+                if (cow)
                 {
                     obj.reset(new memobject { });
                     entry.obj->copy_to(*obj,
@@ -476,45 +924,101 @@ namespace vmm
                         (entry.endp - entry.startp) * psize
                     );
                     lib::panic_if(
-                        !vmspace->map(
+                        !map_locked(*wlocked,
                             entry.startp * psize,
                             (entry.endp - entry.startp) * psize,
                             entry.prot, entry.flags,
-                            obj, entry.offsetp * psize
+                            obj, entry.offsetp * psize,
+                            entry.hints
                         ), "vmm: could not perform copy-on-write"
                     );
                 }
                 else obj = entry.obj;
 
                 pidx = (page - entry.startp) + entry.offsetp;
-                pflags = [prot = entry.prot] {
-                    auto ret = pflag::user;
-                    if (prot & prot::read)
-                        ret |= pflag::read;
-                    if (prot & prot::write)
-                        ret |= pflag::write;
-                    if (prot & prot::exec)
-                        ret |= pflag::exec;
-                    return ret;
-                } ();
+                pflags = to_pflags(entry.prot);
+
+                hints = entry.hints;
+                startp = entry.startp;
+                endp = entry.endp;
+
+                // writes to shared mappings must be visible to every mapper,
+                // and file contents can change under a private mapping, so
+                // only private anonymous memory can alias the zero page
+                may_share_zero = !on_write && (entry.flags & flag::private_) && (entry.flags & flag::anonymous);
             }
 
             if (obj != nullptr)
             {
+                const auto vaddr = page * psize;
+
+                // back the whole aligned block at once so that it gets a large pte
+                const auto hpages = pagemap::from_page_size(page_size::medium) / psize;
+                const auto hstartp = lib::align_down(page, hpages);
+                const bool huge = (hints & hint::hugepage) || obj->prefers_huge();
+                if (huge && obj->is_zero_filled() && hstartp >= startp && hstartp + hpages <= endp)
+                {
+                    const auto hvaddr = hstartp * psize;
+                    const auto hidx = pidx - (page - hstartp);
+                    if (!obj->has_pages(hidx, hpages))
+                    {
+                        if (const auto paddr = pmm::try_alloc<std::uintptr_t>(hpages, true))
+                        {
+                            pmm::split(paddr, hpages);
+                            if (obj->adopt_pages(hidx, paddr, hpages))
+                                return pmap->map(hvaddr, paddr, hpages * psize, pflags).has_value();
+
+                            for (std::size_t i = 0; i < hpages; i++)
+                                pmm::free(paddr + i * psize);
+                        }
+                    }
+
+                    // another mapping of the object already backed the block
+                    if (const auto paddr = obj->contiguous(hidx, hpages); paddr && paddr % (hpages * psize) == 0)
+                        return pmap->map(hvaddr, paddr, hpages * psize, pflags).has_value();
+                }
+
+                if (may_share_zero && obj->is_zero_filled() && obj->peek_page(pidx) == 0)
+                    return pmap->map(vaddr, zero_page(), psize, pflags & ~pflag::write).has_value();
+
                 if (const auto pg = obj->get_page(pidx))
                 {
-                    if (const auto ret = vmspace->pmap->translate(page * psize, page_size::small); ret.has_value() && ret.value() == pg)
+                    if (const auto ret = pmap->translate(vaddr, page_size::small); ret.has_value())
                     {
-                        log::error("vmm: huh? address 0x{:X} is already mapped to 0x{:X}", page * psize, pg);
-                        return false;
+                        if (ret.value() == pg)
+                        {
+                            log::error("vmm: huh? address 0x{:X} is already mapped to 0x{:X}", vaddr, pg);
+                            return false;
+                        }
+
+                        // first write to a page that was backed by the zero page
+                        if (ret.value() == zero_page())
+                            lib::panic_if(!pmap->unmap(vaddr, psize, page_size::small), "vmm: could not unmap the zero page");
                     }
 
-                    if (vmspace->pmap->map(page * psize, pg, psize, pflags))
+                    if (pmap->map(vaddr, pg, psize, pflags))
+                    {
+                        if ((hints & hint::sequential) && !obj->is_zero_filled())
+                        {
+                            const auto count = std::min(readahead_pages, endp - page - 1);
+                            for (std::size_t i = 1; i <= count; i++)
+                            {
+                                if (obj->get_page(pidx + i) == 0)
+                                    break;
+                            }
+                        }
                         return true;
+                    }
                 }
             }
         }
 
         return false;
     }
+
+    bool handle_pfault(std::uintptr_t addr, bool on_write)
+    {
+        const auto proc = sched::this_thread()->parent;
+        return proc->vmspace->fault(addr, on_write);
+    }
 } // namespace vmm
\ No newline at end of file
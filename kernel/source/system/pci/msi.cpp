@@ -0,0 +1,234 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module system.pci;
+
+import system.interrupts;
+import system.cpu;
+import lib;
+import cppstd;
+
+namespace pci
+{
+    namespace
+    {
+        auto allocate_vector(std::size_t cpu, device::irq_handler handler) -> std::optional<device::vector>
+        {
+            auto ret = interrupts::allocate(cpu);
+            if (!ret.has_value())
+                return std::nullopt;
+
+            auto &[irq, vector] = ret.value();
+            irq.set(std::move(handler));
+            return device::vector { cpu, vector };
+        }
+
+        void free_vector(const device::vector &vec)
+        {
+            if (auto handler = interrupts::get(vec.cpu, vec.vector))
+                handler->get().reset_all();
+        }
+    } // namespace
+
+    void device::disable_intx()
+    {
+        const auto val = read<16>(reg::cmd);
+        write<16>(reg::cmd, val | std::to_underlying(cmd::int_dis) | std::to_underlying(cmd::bus_master));
+    }
+
+    auto device::route_msi(std::size_t cpu, irq_handler handler) -> std::optional<vector>
+    {
+        const auto mcap = find_cap(cap::msi);
+        if (!mcap.has_value())
+            return std::nullopt;
+
+        const auto off = mcap.value();
+        auto ctrl = read<16>(off + 2);
+
+        if (msi.route.has_value())
+            unroute_msi();
+
+        const auto vec = allocate_vector(cpu, std::move(handler));
+        if (!vec.has_value())
+            return std::nullopt;
+
+        const auto msg = arch::msi_message(vec->cpu, vec->vector);
+        if (!msg.has_value())
+        {
+            free_vector(vec.value());
+            return std::nullopt;
+        }
+
+        const auto [addr, data] = msg.value();
+        write<32>(off + 4, static_cast<std::uint32_t>(addr));
+        if (ctrl & std::to_underlying(msi::ctrl::bits64))
+        {
+            write<32>(off + 8, static_cast<std::uint32_t>(addr >> 32));
+            write<16>(off + 12, data);
+        }
+        else write<16>(off + 8, data);
+
+        // msi-x and msi are mutually exclusive
+        if (const auto xcap = find_cap(cap::msix))
+        {
+            const auto xctrl = read<16>(xcap.value() + 2);
+            write<16>(xcap.value() + 2, xctrl & ~std::to_underlying(msix::ctrl::enable));
+        }
+
+        ctrl &= ~std::to_underlying(msi::ctrl::mme_mask);
+        ctrl |= std::to_underlying(msi::ctrl::enable);
+        write<16>(off + 2, ctrl);
+
+        disable_intx();
+        return msi.route = vec;
+    }
+
+    void device::unroute_msi()
+    {
+        if (!msi.route.has_value())
+            return;
+
+        if (const auto mcap = find_cap(cap::msi))
+        {
+            const auto ctrl = read<16>(mcap.value() + 2);
+            write<16>(mcap.value() + 2, ctrl & ~std::to_underlying(msi::ctrl::enable));
+        }
+
+        free_vector(msi.route.value());
+        msi.route.reset();
+    }
+
+    bool device::setup_msix()
+    {
+        if (msix.table != 0)
+            return true;
+
+        const auto xcap = find_cap(cap::msix);
+        if (!xcap.has_value())
+            return false;
+
+        const auto off = xcap.value();
+        const auto ctrl = read<16>(off + 2);
+        const auto table = read<32>(off + 4);
+
+        const auto bir = table & 0b111;
+        if (bir >= bars.size() || bars[bir].type != bar::type::mem)
+        {
+            log::error("pci: msi-x table in invalid bar {}", bir);
+            return false;
+        }
+
+        msix.count = (ctrl & std::to_underlying(msix::ctrl::size_mask)) + 1;
+        msix.table = bars[bir].map() + (table & ~0b111u);
+        msix.routes.resize(msix.count);
+
+        // mask everything until it is routed
+        const auto entry_size = std::to_underlying(msix::entry::size);
+        const auto entry_ctrl = std::to_underlying(msix::entry::ctrl);
+        for (std::size_t i = 0; i < msix.count; i++)
+            lib::mmio::out<32>(msix.table + i * entry_size + entry_ctrl, msix::entry_masked);
+
+        write<16>(off + 2, (ctrl | std::to_underlying(msix::ctrl::enable)) & ~std::to_underlying(msix::ctrl::function_mask));
+
+        if (const auto mcap = find_cap(cap::msi))
+        {
+            const auto mctrl = read<16>(mcap.value() + 2);
+            write<16>(mcap.value() + 2, mctrl & ~std::to_underlying(msi::ctrl::enable));
+        }
+
+        disable_intx();
+        return true;
+    }
+
+    std::size_t device::msix_count()
+    {
+        if (!setup_msix())
+            return 0;
+        return msix.count;
+    }
+
+    auto device::route_msix(std::size_t idx, std::size_t cpu, irq_handler handler) -> std::optional<vector>
+    {
+        if (!setup_msix() || idx >= msix.count)
+            return std::nullopt;
+        return program_msix(idx, allocate_vector(cpu, std::move(handler)));
+    }
+
+    auto device::route_msix_threaded(
+        std::size_t idx, std::size_t cpu,
+        std::function<interrupts::irq_return (cpu::registers *)> quick,
+        std::function<void ()> handler, bool oneshot) -> std::optional<vector>
+    {
+        if (!setup_msix() || idx >= msix.count)
+            return std::nullopt;
+
+        const auto ret = interrupts::allocate(cpu);
+        if (!ret.has_value())
+            return std::nullopt;
+        const vector vec { cpu, ret->second };
+
+        // there is no line behind an msi-x vector, oneshot masks the entry instead
+        const auto mask = [this, idx](bool masked) { mask_msix(idx, masked); };
+        if (!interrupts::set_threaded(cpu, vec.vector, std::move(quick), std::move(handler), oneshot, mask))
+        {
+            free_vector(vec);
+            return std::nullopt;
+        }
+        return program_msix(idx, vec);
+    }
+
+    auto device::program_msix(std::size_t idx, std::optional<vector> vec) -> std::optional<vector>
+    {
+        if (!vec.has_value())
+            return std::nullopt;
+
+        const auto msg = arch::msi_message(vec->cpu, vec->vector);
+        if (!msg.has_value())
+        {
+            free_vector(vec.value());
+            return std::nullopt;
+        }
+
+        // the entry must be masked while it is rewritten
+        mask_msix(idx, true);
+
+        const auto entry = msix.table + idx * std::to_underlying(msix::entry::size);
+        const auto [addr, data] = msg.value();
+        lib::mmio::out<32>(entry + std::to_underlying(msix::entry::addr_low), static_cast<std::uint32_t>(addr));
+        lib::mmio::out<32>(entry + std::to_underlying(msix::entry::addr_high), static_cast<std::uint32_t>(addr >> 32));
+        lib::mmio::out<32>(entry + std::to_underlying(msix::entry::data), data);
+
+        if (auto &old = msix.routes[idx]; old.has_value())
+            free_vector(old.value());
+        msix.routes[idx] = vec;
+
+        mask_msix(idx, false);
+        return vec;
+    }
+
+    void device::unroute_msix(std::size_t idx)
+    {
+        if (msix.table == 0 || idx >= msix.count || !msix.routes[idx].has_value())
+            return;
+
+        mask_msix(idx, true);
+        free_vector(msix.routes[idx].value());
+        msix.routes[idx].reset();
+    }
+
+    void device::mask_msix(std::size_t idx, bool masked)
+    {
+        if (msix.table == 0 || idx >= msix.count)
+            return;
+
+        const auto ctrl = msix.table + idx * std::to_underlying(msix::entry::size) + std::to_underlying(msix::entry::ctrl);
+        auto val = lib::mmio::in<32>(ctrl);
+        if (masked)
+            val |= msix::entry_masked;
+        else
+            val &= ~msix::entry_masked;
+        lib::mmio::out<32>(ctrl, val);
+
+        // flush the posted write
+        lib::unused(lib::mmio::in<32>(ctrl));
+    }
+} // namespace pci
@@ -0,0 +1,111 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module system.rcu;
+
+import system.scheduler;
+import system.cpu.self;
+import system.cpu;
+import lib;
+import cppstd;
+
+namespace rcu
+{
+    namespace
+    {
+        // how often the rcu thread looks for new callbacks
+        constexpr std::size_t callback_delay = 10;
+
+        std::atomic_size_t gp_seq = 0;
+
+        // the latest grace period this cpu has passed a quiescent state in
+        cpu_local<std::atomic_size_t> qs_seq;
+        cpu_local_init(qs_seq, 0uz);
+
+        constinit lib::spinlock_irq pending_lock;
+        constinit head *pending = nullptr;
+
+        [[noreturn]] void callback_thread()
+        {
+            while (true)
+            {
+                pending_lock.lock();
+                auto list = std::exchange(pending, nullptr);
+                pending_lock.unlock();
+
+                if (list == nullptr)
+                {
+                    sched::sleep_for(callback_delay);
+                    continue;
+                }
+
+                synchronize();
+
+                // oldest first
+                head *ordered = nullptr;
+                while (list != nullptr)
+                {
+                    const auto node = std::exchange(list, list->next);
+                    node->next = ordered;
+                    ordered = node;
+                }
+
+                while (ordered != nullptr)
+                {
+                    const auto node = std::exchange(ordered, ordered->next);
+                    node->func(node);
+                }
+            }
+        }
+    } // namespace
+
+    void read_lock() { sched::disable(); }
+    void read_unlock() { sched::enable(); }
+
+    void quiescent()
+    {
+        if (!cpu::local::available())
+            return;
+        qs_seq->store(gp_seq.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    void synchronize()
+    {
+        // nothing can be preempted yet
+        if (!sched::is_initialised())
+            return;
+
+        const auto target = gp_seq.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+        // we are not in a read side section ourselves
+        quiescent();
+
+        for (std::size_t i = 0; i < cpu::count(); i++)
+        {
+            if (!cpu::nth(i)->online.load(std::memory_order_acquire))
+                continue;
+
+            const auto &seq = qs_seq.get(cpu::local::nth_base(i));
+            while (seq.load(std::memory_order_acquire) < target)
+                sched::sleep_for(1);
+        }
+    }
+
+    void call(head *node, void (*func)(head *))
+    {
+        node->func = func;
+
+        pending_lock.lock();
+        node->next = pending;
+        pending = node;
+        pending_lock.unlock();
+    }
+
+    lib::initgraph::task callback_task
+    {
+        "rcu.callbacks.spawn",
+        lib::initgraph::postsched_init_engine,
+        [] {
+            sched::spawn(0, reinterpret_cast<std::uintptr_t>(callback_thread));
+        }
+    };
+} // namespace rcu
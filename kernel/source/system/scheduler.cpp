@@ -2,21 +2,45 @@
 
 module system.scheduler;
 
+import drivers.fs.procfs;
 import drivers.timers;
 import system.cpu.self;
 import system.memory;
 import system.time;
+import system.rcu;
+import system.smp;
+import system.hrtimer;
 import system.acpi;
 import magic_enum;
 import frigg;
 import boot;
+import fmt;
 import arch;
 import lib;
 import cppstd;
 
 namespace sched
 {
-    class percpu
+    // ready to use kernel stacks and thread objects kept around by each cpu
+    constexpr std::size_t kstack_cache_size = 8;
+    constexpr std::size_t thread_cache_size = 16;
+
+    // a woken fair thread preempts the running one only if it is this far behind it,
+    // can be changed with sched_wakeup_granularity_ns= on the command line
+    constexpr std::size_t default_wakeup_granularity = 1'000'000;
+    // how much of a head start sleepers get over the threads that kept running
+    constexpr std::size_t sleeper_credit = timeslice * 1'000'000 / 2;
+
+    // idle cpus spin for an adaptive window before going to sleep, in ns
+    constexpr std::size_t idle_poll_start = 5'000;
+    constexpr std::size_t idle_poll_max = 200'000;
+    // expected idle periods longer than this use the deepest sleep state
+    constexpr std::size_t idle_deep_threshold = 1'000'000;
+
+    // how long a sleep timer that raced with its thread waits before trying again
+    constexpr std::size_t sleep_retry = 10'000;
+
+    class run_queue
     {
         private:
         template<typename MType, MType thread::*Member>
@@ -29,26 +53,108 @@ namespace sched
             }
         };
 
-        public:
-        lib::locker<
-            lib::rbtree<
-                thread, &thread::rbtree_hook,
-                compare<
-                    std::uint64_t,
-                    &thread::vruntime
-                >
-            >, lib::spinlock_preempt
-        > queue;
+        using rt_list = frg::intrusive_list<
+            thread,
+            frg::locate_member<
+                thread,
+                frg::default_list_hook<thread>,
+                &thread::rt_hook
+            >
+        >;
 
-        thread *running_thread;
+        static constexpr std::size_t rt_levels = rt_prio_max + 1;
+        static constexpr std::size_t bitmap_words = lib::div_roundup(rt_levels, 64);
+
+        std::array<rt_list, rt_levels> _rt;
+        std::array<std::uint64_t, bitmap_words> _bitmap { };
+        std::size_t _rt_count = 0;
+
+        // mirrors size() for readers that don't take the lock
+        std::atomic_size_t &_nr_queued;
+
+        public:
+        run_queue(std::atomic_size_t &nr_queued) : _nr_queued { nr_queued } { }
 
         lib::rbtree<
             thread, &thread::rbtree_hook,
             compare<
-                std::optional<std::size_t>,
-                &thread::sleep_until
+                std::uint64_t,
+                &thread::vruntime
             >
-        > sleep_queue;
+        > fair;
+
+        void insert(thread *thread, bool front = false)
+        {
+            lib::bug_on(thread->queued);
+            thread->queued = true;
+            _nr_queued.fetch_add(1, std::memory_order_relaxed);
+
+            if (thread->policy == policy::other)
+            {
+                fair.insert(thread);
+                return;
+            }
+
+            const auto prio = thread->rt_priority;
+            if (front)
+                _rt[prio].push_front(thread);
+            else
+                _rt[prio].push_back(thread);
+
+            _bitmap[prio / 64] |= (1ul << (prio % 64));
+            _rt_count++;
+        }
+
+        void remove(thread *thread)
+        {
+            lib::bug_on(!thread->queued);
+            thread->queued = false;
+            _nr_queued.fetch_sub(1, std::memory_order_relaxed);
+
+            if (thread->policy == policy::other)
+            {
+                fair.remove(thread);
+                return;
+            }
+
+            const auto prio = thread->rt_priority;
+            auto &list = _rt[prio];
+            list.erase(list.iterator_to(thread));
+            if (list.empty())
+                _bitmap[prio / 64] &= ~(1ul << (prio % 64));
+            _rt_count--;
+        }
+
+        // highest queued real-time priority below the given one, 0 if none
+        std::size_t next_rt(std::size_t below = rt_levels) const
+        {
+            for (std::size_t i = std::min(below, rt_levels) / 64 + 1; i-- > 0; )
+            {
+                auto word = _bitmap[i];
+                if (below < (i + 1) * 64)
+                    word &= (1ul << (below % 64)) - 1;
+                if (word != 0)
+                    return i * 64 + std::bit_width(word) - 1;
+            }
+            return 0;
+        }
+
+        rt_list &rt_at(std::size_t prio) { return _rt[prio]; }
+
+        std::size_t rt_size() const { return _rt_count; }
+        std::size_t size() const { return fair.size() + _rt_count; }
+    };
+
+    class percpu
+    {
+        public:
+        // queued threads, for load estimates that don't need the lock
+        std::atomic_size_t nr_queued = 0;
+        // threads are woken up from interrupt handlers, so this has to keep
+        // interrupts off while held
+        lib::locker<run_queue, lib::spinlock_irq> queue { nr_queued };
+
+        thread *running_thread;
 
         process *idle_proc;
         thread *idle_thread;
@@ -63,8 +169,33 @@ namespace sched
             >
         > dead_threads;
 
+        std::array<std::uintptr_t, kstack_cache_size> kstack_cache;
+        std::size_t kstack_cached = 0;
+
+        std::array<void *, thread_cache_size> thread_cache;
+        std::size_t thread_cached = 0;
+
+        // real-time throttling
+        std::uint64_t rt_period_start = 0;
+        std::uint64_t rt_time = 0;
+
         std::atomic_size_t preemption = 0;
         std::atomic_bool in_scheduler = false;
+
+        // a reschedule was requested. the idle thread watches this
+        // line with monitor/mwait, so keep it away from everything else
+        alignas(64) std::atomic_bool need_resched = false;
+        // set while the idle thread notices need_resched without an ipi.
+        // written right before mwait, which would wake up on this line
+        alignas(64) std::atomic_bool polling = false;
+
+        alignas(64) std::size_t idle_poll = idle_poll_start;
+        std::uint64_t idle_avg = 0;
+
+        std::atomic_uint64_t idle_time = 0;
+        std::atomic_uint64_t idle_wakes = 0;
+        std::atomic_uint64_t idle_poll_wakes = 0;
+        std::atomic_uint64_t idle_monitor_wakes = 0;
     };
 
     cpu_local<percpu> percpu;
@@ -74,6 +205,13 @@ namespace sched
     {
         void init();
         void reschedule(std::size_t ms);
+        // make another cpu reschedule as soon as possible
+        void kick(std::size_t cpu_idx);
+
+        // whether idle_wait wakes up on a store to the flag without an interrupt
+        bool can_monitor();
+        // wait until the flag is set or an interrupt arrives
+        void idle_wait(const std::atomic_bool &flag, bool deep);
 
         void finalise(process *proc, thread *thread, std::uintptr_t ip);
         void deinitialise(process *proc, thread *thread);
@@ -82,6 +220,9 @@ namespace sched
         void load(thread *thread);
 
         void update_stack(thread *thread, std::uintptr_t addr);
+
+        // size of the state that is allocated right after each thread object
+        std::size_t state_size();
     } // namespace arch
 
     namespace
@@ -108,6 +249,8 @@ namespace sched
 
         bool initialised = false;
 
+        void activate(thread *thread);
+
         std::size_t alloc_pid(process *proc)
         {
             static std::atomic_size_t next_pid = 0;
@@ -132,7 +275,148 @@ namespace sched
 
         void idle()
         {
-            ::arch::halt(true);
+            auto &pcpu = percpu.get();
+            const auto clock = time::main_clock();
+            const bool monitor = arch::can_monitor();
+
+            while (true)
+            {
+                rcu::quiescent();
+                const auto start = clock->ns();
+
+                // threads queued here while polling only need to set need_resched
+                pcpu.polling.store(true);
+                while (!pcpu.need_resched.load() && clock->ns() - start < pcpu.idle_poll)
+                    ::arch::pause();
+
+                const bool polled = pcpu.need_resched.load();
+                if (!polled)
+                {
+                    // hlt needs an ipi to wake up
+                    if (!monitor)
+                        pcpu.polling.store(false);
+                    arch::idle_wait(pcpu.need_resched, pcpu.idle_avg > idle_deep_threshold);
+                }
+                pcpu.polling.store(false);
+
+                const auto residency = clock->ns() - start;
+                pcpu.idle_avg = (pcpu.idle_avg * 7 + residency) / 8;
+
+                // keep polling as long as wakeups come in shortly after we stop
+                if (!polled)
+                {
+                    if (residency <= idle_poll_max)
+                        pcpu.idle_poll = std::clamp(pcpu.idle_poll * 2, idle_poll_start, idle_poll_max);
+                    else
+                        pcpu.idle_poll = std::max(pcpu.idle_poll / 2, idle_poll_start);
+                }
+
+                pcpu.idle_time.fetch_add(residency, std::memory_order_relaxed);
+                pcpu.idle_wakes.fetch_add(1, std::memory_order_relaxed);
+
+                if (pcpu.need_resched.load())
+                {
+                    if (polled)
+                        pcpu.idle_poll_wakes.fetch_add(1, std::memory_order_relaxed);
+                    else if (monitor)
+                        pcpu.idle_monitor_wakes.fetch_add(1, std::memory_order_relaxed);
+                    arch::reschedule(0);
+                }
+            }
+        }
+
+        // stacks are preceded by an unmapped guard page to catch overflows
+        constexpr std::size_t kstack_guard_size = pmm::page_size;
+
+        // stacks that didn't fit in the per cpu caches. they stay mapped, other
+        // cpus that ran on them may still have global tlb entries for them
+        lib::locker<
+            std::vector<std::uintptr_t>,
+            lib::spinlock
+        > free_kstacks;
+
+        std::uintptr_t alloc_kstack()
+        {
+            disable();
+            if (auto &pcpu = percpu.get(); pcpu.kstack_cached != 0)
+            {
+                const auto top = pcpu.kstack_cache[--pcpu.kstack_cached];
+                enable();
+                return top;
+            }
+            enable();
+
+            std::uintptr_t top = 0;
+            {
+                auto locked = free_kstacks.lock();
+                if (!locked->empty())
+                {
+                    top = locked->back();
+                    locked->pop_back();
+                }
+            }
+
+            if (top != 0)
+                return top;
+
+            const auto pages = (kstack_guard_size + boot::kstack_size) / pmm::page_size;
+            top = vmm::alloc_vspace(pages) + kstack_guard_size + boot::kstack_size;
+
+            lib::panic_if(
+                !vmm::kernel_pagemap->map_alloc(top - boot::kstack_size, boot::kstack_size, vmm::pflag::rwg),
+                "sched: could not map a kernel stack"
+            );
+            return top;
+        }
+
+        void free_kstack(std::uintptr_t top)
+        {
+            disable();
+            if (auto &pcpu = percpu.get(); pcpu.kstack_cached != kstack_cache_size)
+            {
+                pcpu.kstack_cache[pcpu.kstack_cached++] = top;
+                enable();
+                return;
+            }
+            enable();
+
+            free_kstacks.lock()->push_back(top);
+        }
+
+        std::size_t thread_pages()
+        {
+            const auto size = lib::align_up(sizeof(thread), 64) + arch::state_size();
+            return lib::div_roundup(size, pmm::page_size);
+        }
+
+        void *alloc_thread()
+        {
+            disable();
+            if (auto &pcpu = percpu.get(); pcpu.thread_cached != 0)
+            {
+                const auto ptr = pcpu.thread_cache[--pcpu.thread_cached];
+                enable();
+                return ptr;
+            }
+            enable();
+
+            return reinterpret_cast<void *>(lib::tohh(pmm::alloc<std::uintptr_t>(thread_pages())));
+        }
+
+        void free_thread(thread *thread)
+        {
+            std::destroy_at(thread);
+
+            disable();
+            if (auto &pcpu = percpu.get(); pcpu.thread_cached != thread_cache_size)
+            {
+                pcpu.thread_cache[pcpu.thread_cached++] = thread;
+                enable();
+                return;
+            }
+            enable();
+
+            pmm::free(lib::fromhh(reinterpret_cast<std::uintptr_t>(thread)), thread_pages());
         }
     } // namespace
 
@@ -240,17 +524,65 @@ namespace sched
     }
 
     void thread::prepare_sleep(std::size_t ms)
+    {
+        prepare_sleep_ns(ms * 1'000'000);
+    }
+
+    void thread::prepare_sleep_ns(std::size_t ns)
     {
         sleep_ints = ::arch::int_switch_status(false);
         sleep_lock.lock();
         status = status::sleeping;
 
-        if (ms)
-            sleep_for = ms * 1'000'000;
+        if (ns)
+            sleep_for = ns;
         else
             sleep_for = std::nullopt;
     }
 
+    namespace
+    {
+        // with sleep_lock held, drops it
+        void finish_sleep(thread *thread, std::size_t reason)
+        {
+            thread->sleep_until = std::nullopt;
+            thread->status = status::ready;
+            thread->wake_reason = reason;
+            thread->sleep_lock.unlock();
+
+            activate(thread);
+        }
+
+        // sleep_timer callback
+        void sleep_expired(thread *thread)
+        {
+            const auto now = time::main_clock()->ns();
+
+            // it is still switching out or someone else is waking it up
+            if (!thread->sleep_lock.try_lock())
+            {
+                hrtimer::arm(thread->sleep_timer, now + sleep_retry);
+                return;
+            }
+
+            if (thread->status != status::sleeping || !thread->sleep_until.has_value())
+            {
+                thread->sleep_lock.unlock();
+                return;
+            }
+
+            // a stale retry for an earlier sleep
+            if (now < thread->sleep_until.value())
+            {
+                hrtimer::arm(thread->sleep_timer, thread->sleep_until.value());
+                thread->sleep_lock.unlock();
+                return;
+            }
+
+            finish_sleep(thread, wake_reason::success);
+        }
+    } // namespace
+
     bool thread::wake_up(std::size_t reason)
     {
         const bool ints = ::arch::int_switch_status(false);
@@ -263,17 +595,19 @@ namespace sched
             return false;
         }
 
-        status = status::ready;
-        wake_reason = reason;
+        // the callback only ever try_locks sleep_lock, so waiting for it is fine
+        hrtimer::cancel(sleep_timer);
+        finish_sleep(this, reason);
 
-        sleep_lock.unlock();
         ::arch::int_switch(ints);
         return true;
     }
 
     thread::~thread()
     {
-        lib::free(kstack_top - boot::kstack_size);
+        // a dead thread never sleeps, so its timer can't re-arm itself after this
+        hrtimer::cancel(sleep_timer);
+        free_kstack(kstack_top);
 
         if (is_user)
         {
@@ -293,16 +627,25 @@ namespace sched
     thread *thread::create(process *parent, std::uintptr_t ip, bool is_user)
     {
         lib::bug_on(!parent);
-        auto thread = new sched::thread { };
+        auto thread = std::construct_at(static_cast<sched::thread *>(alloc_thread()));
 
         thread->tid = parent->next_tid++;
         thread->parent = parent;
         thread->status = status::not_ready;
         thread->is_user = is_user;
         thread->priority = default_prio;
+        thread->policy = policy::other;
+        thread->rt_priority = 0;
+        thread->rr_left = rr_timeslice * 1'000'000;
+        thread->affinity = all_cpus;
+        thread->cpu = cpu::self()->idx;
+        thread->queued = false;
+        thread->yielded = false;
         thread->vruntime = 0;
+        thread->cpu_time = 0;
+        thread->sleep_timer.func = [thread] { sleep_expired(thread); };
 
-        const auto stack = lib::alloc<std::uintptr_t>(boot::kstack_size) + boot::kstack_size;
+        const auto stack = alloc_kstack();
         thread->kstack_top = stack;
 
         if (is_user)
@@ -315,7 +658,7 @@ namespace sched
             lib::panic_if(!vmspace->map(
                 vaddr, boot::ustack_size,
                 vmm::prot::read | vmm::prot::write,
-                vmm::flag::private_ | vmm::flag::untouchable, obj, 0
+                vmm::flag::private_ | vmm::flag::anonymous | vmm::flag::untouchable, obj, 0
             ));
 
             thread->ustack_obj = obj;
@@ -392,6 +735,12 @@ namespace sched
         return yield();
     }
 
+    std::size_t sleep_for_ns(std::size_t ns)
+    {
+        this_thread()->prepare_sleep_ns(ns);
+        return yield();
+    }
+
     std::size_t yield()
     {
         auto thread = this_thread();
@@ -406,9 +755,10 @@ namespace sched
                 const auto clock = time::main_clock();
                 thread->sleep_until = clock->ns() + thread->sleep_for.value();
                 thread->sleep_for = std::nullopt;
+                hrtimer::arm(thread->sleep_timer, thread->sleep_until.value());
             }
-            percpu->sleep_queue.insert(thread);
         }
+        else thread->yielded = true;
 
         ::arch::int_switch(true);
         arch::reschedule(0);
@@ -417,15 +767,117 @@ namespace sched
         return eeping ? thread->wake_reason : wake_reason::success;
     }
 
-    std::size_t allocate_cpu()
+    namespace
+    {
+        cpumask parse_cpulist(std::string_view str)
+        {
+            cpumask mask { };
+
+            const auto number = [&str] -> std::optional<std::size_t>
+            {
+                std::size_t ret = 0, len = 0;
+                for (; len < str.size() && str[len] >= '0' && str[len] <= '9'; len++)
+                    ret = ret * 10 + (str[len] - '0');
+                str.remove_prefix(len);
+                if (len == 0)
+                    return std::nullopt;
+                return ret;
+            };
+
+            while (!str.empty())
+            {
+                const auto first = number();
+                if (!first.has_value())
+                    break;
+
+                auto last = first;
+                if (str.starts_with('-'))
+                {
+                    str.remove_prefix(1);
+                    last = number();
+                    if (!last.has_value())
+                        break;
+                }
+
+                for (auto i = first.value(); i <= last.value() && i < max_cpus; i++)
+                    mask.set(i);
+
+                if (!str.starts_with(','))
+                    break;
+                str.remove_prefix(1);
+            }
+            return mask;
+        }
+
+        // run func on the run queue this thread belongs to while holding its lock
+        template<typename Func>
+        void with_queue_of(thread *thread, Func &&func)
+        {
+            while (true)
+            {
+                const auto cpu_idx = thread->cpu;
+                auto locked = percpu.get(cpu::local::nth_base(cpu_idx)).queue.lock();
+                if (thread->cpu != cpu_idx)
+                    continue;
+                func(*locked, cpu_idx);
+                return;
+            }
+        }
+    } // namespace
+
+    const cpumask &online_cpus()
+    {
+        static const auto cached = [] {
+            cpumask mask { };
+            for (std::size_t i = 0; i < cpu::count(); i++)
+                mask.set(i);
+            return mask;
+        } ();
+        return cached;
+    }
+
+    const cpumask &isolated_cpus()
+    {
+        static const auto cached = [] {
+            const auto option = boot::cmdline_option("isolcpus");
+            auto mask = option ? parse_cpulist(option.value()) : cpumask { };
+            mask &= online_cpus();
+
+            // keep at least one cpu for housekeeping
+            if (mask == online_cpus())
+                mask.reset(cpu::bsp_idx());
+            return mask;
+        } ();
+        return cached;
+    }
+
+    namespace
     {
+        // isolated cpus are only used when the mask leaves no other choice
+        cpumask placeable(const cpumask &mask)
+        {
+            const auto allowed = mask & online_cpus();
+            lib::bug_on(allowed.none());
+
+            const auto housekeeping = allowed & ~isolated_cpus();
+            return housekeeping.any() ? housekeeping : allowed;
+        }
+    } // namespace
+
+    std::size_t allocate_cpu(const cpumask &mask)
+    {
+        const auto allowed = placeable(mask);
+
         std::size_t idx = 0;
         std::size_t min = std::numeric_limits<std::size_t>::max();
 
         for (std::size_t i = 0; i < cpu::count(); i++)
         {
+            if (!allowed[i])
+                continue;
+
             auto &obj = percpu.get(cpu::local::nth_base(i));
-            const auto size = obj.queue.lock()->size();
+            const auto size = obj.nr_queued.load(std::memory_order_relaxed);
             if (size < min)
             {
                 min = size;
@@ -435,28 +887,220 @@ namespace sched
         return idx;
     }
 
-    void enqueue(thread *thread, std::size_t cpu_idx)
+    namespace
     {
-        auto &obj = percpu.get(cpu::local::nth_base(cpu_idx));
-        switch (thread->status)
+        void requeue(thread *thread, std::size_t cpu_idx, bool front)
         {
-            [[unlikely]] case status::killed:
-            [[unlikely]] case status::not_ready:
-            [[unlikely]] case status::sleeping:
-                lib::panic(
-                    "can't enqueue a thread that is {}",
-                    magic_enum::enum_name(thread->status)
-                );
-                break;
-            [[likely]] case status::running:
-                thread->status = status::ready;
-                [[fallthrough]];
-            case status::ready:
-                obj.queue.lock()->insert(thread);
-                break;
-            default:
-                std::unreachable();
+            auto &obj = percpu.get(cpu::local::nth_base(cpu_idx));
+            switch (thread->status)
+            {
+                [[unlikely]] case status::killed:
+                [[unlikely]] case status::not_ready:
+                [[unlikely]] case status::sleeping:
+                    lib::panic(
+                        "can't enqueue a thread that is {}",
+                        magic_enum::enum_name(thread->status)
+                    );
+                    break;
+                [[likely]] case status::running:
+                    thread->status = status::ready;
+                    [[fallthrough]];
+                case status::ready:
+                {
+                    auto locked = obj.queue.lock();
+                    thread->cpu = cpu_idx;
+                    locked->insert(thread, front);
+                    break;
+                }
+                default:
+                    std::unreachable();
+            }
+        }
+
+        std::size_t wakeup_granularity()
+        {
+            static const auto cached = [] {
+                std::size_t ns = 0;
+                const auto option = boot::cmdline_option("sched_wakeup_granularity_ns");
+                if (!option.has_value() || option->empty())
+                    return default_wakeup_granularity;
+                for (const auto ch : option.value())
+                {
+                    if (ch < '0' || ch > '9')
+                        return default_wakeup_granularity;
+                    ns = ns * 10 + (ch - '0');
+                }
+                return ns;
+            } ();
+            return cached;
+        }
+
+        std::size_t load_of(std::size_t cpu_idx)
+        {
+            // only a hint, not worth taking a remote lock for
+            auto &obj = percpu.get(cpu::local::nth_base(cpu_idx));
+            const auto size = obj.nr_queued.load(std::memory_order_relaxed);
+            return size + (obj.running_thread != obj.idle_thread);
+        }
+
+        // pick a cpu for a thread that just woken up
+        std::size_t select_wake_cpu(thread *thread)
+        {
+            const auto allowed = placeable(thread->affinity);
+            const auto prev = thread->cpu;
+            const auto self = cpu::self()->idx;
+
+            // the cpu it last ran on may still have its cache warm, but a waker
+            // and a wakee usually work on the same data, so pull it over
+            // unless that would leave the waker's cpu busier
+            auto target = prev;
+            if (allowed[self] && self != prev && (!allowed[prev] || load_of(self) < load_of(prev)))
+                target = self;
+            if (!allowed[target])
+                return allocate_cpu(thread->affinity);
+
+            if (load_of(target) == 0)
+                return target;
+
+            // no topology information is available, so any idle cpu will do
+            for (std::size_t i = 0; i < cpu::count(); i++)
+            {
+                if (allowed[i] && load_of(i) == 0)
+                    return i;
+            }
+            return target;
+        }
+
+        // does a newly queued thread deserve the cpu more than what is running on it
+        bool should_preempt(class percpu &obj, thread *woken, std::uint64_t now)
+        {
+            const auto curr = obj.running_thread;
+            if (curr == nullptr || curr == obj.idle_thread)
+                return true;
+
+            if (woken->policy != policy::other)
+                return curr->policy == policy::other || woken->rt_priority > curr->rt_priority;
+            if (curr->policy != policy::other)
+                return false;
+
+            static constexpr std::size_t weight0 = prio_to_weight(0);
+            const auto ran = now > curr->schedule_time ? now - curr->schedule_time : 0;
+            const auto vruntime = curr->vruntime + (ran * weight0) / prio_to_weight(curr->priority);
+            const auto gran = (wakeup_granularity() * weight0) / prio_to_weight(woken->priority);
+            return vruntime > woken->vruntime + gran;
+        }
+
+        // give a woken thread a small head start over the threads that kept running,
+        // without letting a long sleep turn into a long stretch on the cpu
+        void place(class percpu &obj, run_queue &queue, thread *thread)
+        {
+            std::optional<std::uint64_t> min { };
+            if (!queue.fair.empty())
+                min = queue.fair.first()->vruntime;
+
+            const auto curr = obj.running_thread;
+            if (curr && curr != obj.idle_thread && curr->policy == policy::other)
+                min = std::min(min.value_or(curr->vruntime), curr->vruntime);
+
+            if (!min.has_value())
+                return;
+
+            const auto floor = min.value() > sleeper_credit ? min.value() - sleeper_credit : 0;
+            thread->vruntime = std::max(thread->vruntime, floor);
+        }
+
+        void resched(std::size_t cpu_idx)
+        {
+            if (cpu_idx == cpu::self()->idx)
+            {
+                arch::reschedule(0);
+                return;
+            }
+
+            // an idle cpu that is polling or monitoring the flag will notice the store
+            auto &obj = percpu.get(cpu::local::nth_base(cpu_idx));
+            obj.need_resched.store(true);
+            if (!obj.polling.load())
+                arch::kick(cpu_idx);
+        }
+
+        // queue a thread that became runnable and preempt the cpu it lands on if needed
+        void activate(thread *thread)
+        {
+            lib::bug_on(thread->status != status::ready);
+
+            const auto cpu_idx = select_wake_cpu(thread);
+            auto &obj = percpu.get(cpu::local::nth_base(cpu_idx));
+
+            bool preempt = false;
+            {
+                auto locked = obj.queue.lock();
+                if (thread->policy == policy::other)
+                    place(obj, *locked, thread);
+
+                thread->cpu = cpu_idx;
+                locked->insert(thread);
+                preempt = should_preempt(obj, thread, time::main_clock()->ns());
+            }
+
+            if (preempt)
+                resched(cpu_idx);
         }
+    } // namespace
+
+    void enqueue(thread *thread, std::size_t cpu_idx)
+    {
+        requeue(thread, cpu_idx, false);
+    }
+
+    void set_policy(thread *thread, policy policy, std::size_t rt_priority)
+    {
+        lib::bug_on(policy != policy::other && (rt_priority < rt_prio_min || rt_priority > rt_prio_max));
+        if (policy == policy::other)
+            rt_priority = 0;
+
+        with_queue_of(thread, [&](run_queue &queue, std::size_t)
+        {
+            const bool queued = thread->queued;
+            if (queued)
+                queue.remove(thread);
+
+            // do not let a thread that leaves the real-time class jump ahead of or
+            // fall behind the fair threads it is going to compete with
+            if (policy == policy::other && thread->policy != policy::other && !queue.fair.empty())
+                thread->vruntime = queue.fair.first()->vruntime;
+
+            thread->policy = policy;
+            thread->rt_priority = rt_priority;
+            thread->rr_left = rr_timeslice * 1'000'000;
+
+            if (queued)
+                queue.insert(thread);
+        });
+    }
+
+    void set_affinity(thread *thread, const cpumask &mask)
+    {
+        lib::bug_on((mask & online_cpus()).none());
+
+        bool move = false;
+        with_queue_of(thread, [&](run_queue &queue, std::size_t cpu_idx)
+        {
+            thread->affinity = mask;
+            if (thread->queued && !mask[cpu_idx])
+            {
+                queue.remove(thread);
+                move = true;
+            }
+        });
+
+        // a thread running elsewhere is moved by its cpu on the next reschedule
+        if (move)
+            requeue(thread, allocate_cpu(mask), false);
+        else if (thread == this_thread() && !mask[cpu::self()->idx])
+            yield();
+        else if (thread->status == status::running && !mask[thread->cpu])
+            arch::kick(thread->cpu);
     }
 
     thread *spawn(pid_t pid, std::uintptr_t ip, nice_t priority)
@@ -483,7 +1127,7 @@ namespace sched
             {
                 if (dead.empty())
                 {
-                    me->status = status::sleeping;
+                    me->prepare_sleep();
                     lib::bug_on(me->sleep_until.has_value());
                     yield();
                     lib::bug_on(dead.empty());
@@ -501,6 +1145,16 @@ namespace sched
                 list.push_back(dead.pop_front());
             enable();
 
+            // lookups by tid and mutex spinners can still be looking at
+            // these threads under rcu until the grace period ends
+            for (const auto thread : list)
+            {
+                const auto proc = thread->parent;
+                const std::unique_lock _ { proc->lock };
+                lib::bug_on(proc->threads.erase(thread->tid) != 1);
+            }
+            rcu::synchronize();
+
             while (!list.empty())
             {
                 // TODO
@@ -508,9 +1162,7 @@ namespace sched
                 list.pop_front();
 
                 auto proc = thread->parent;
-                lib::bug_on(proc->threads.erase(thread->tid) != 1);
-
-                delete thread;
+                free_thread(thread);
                 if (proc->threads.empty())
                     lib::panic("TODO: process {} exit", proc->pid);
             }
@@ -518,83 +1170,22 @@ namespace sched
         std::unreachable();
     }
 
-    void sleeper()
-    {
-        auto &eepers = percpu->sleep_queue;
-        auto &dead = percpu->dead_threads;
-        while (true)
-        {
-            while (true)
-            {
-                if (!eepers.empty())
-                    break;
-                yield();
-            }
-
-            const auto clock = time::main_clock();
-            const auto time = clock->ns();
-
-            disable();
-            const auto begin = eepers.begin();
-            for (auto it = begin; it != eepers.end(); )
-            {
-                const auto thread = (it++).value();
-                if (!thread->sleep_until.has_value())
-                {
-                    switch (thread->status)
-                    {
-                        case status::ready:
-                            eepers.remove(thread);
-                            percpu->queue.lock()->insert(thread);
-                            break;
-                        case status::killed:
-                            eepers.remove(thread);
-                            dead.push_back(thread);
-                            break;
-                        case status::not_ready:
-                        case status::sleeping:
-                            continue;
-                        case status::running:
-                            lib::panic("found a running thread in sleep queue");
-                            std::unreachable();
-                        default:
-                            std::unreachable();
-                    }
-                }
-                else
-                {
-                    if (time < thread->sleep_until.value())
-                        break;
-
-                    eepers.remove(thread);
-
-                    thread->sleep_until = std::nullopt;
-                    thread->status = status::ready;
-                    thread->wake_reason = wake_reason::success;
-                    {
-                        // do not starve out other threads
-                        // if the woken one has been sleeping for too long
-                        auto qlocked = percpu->queue.lock();
-                        thread->vruntime = begin->vruntime;
-                        qlocked->insert(thread);
-                    }
-                }
-            }
-            enable();
-            yield();
-        }
-        std::unreachable();
-    }
-
     void schedule(cpu::registers *regs)
     {
         auto &pcpu = percpu.get();
         if (pcpu.preemption.load(std::memory_order_acquire) > 0)
         {
+            pcpu.need_resched.store(true, std::memory_order_release);
             arch::reschedule(timeslice);
             return;
         }
         pcpu.in_scheduler.store(true, std::memory_order_release);
+        pcpu.need_resched.store(false, std::memory_order_release);
+
+        // preemption is enabled, so nothing here is in a read side section
+        rcu::quiescent();
+
+        time::tick();
 
         const auto clock = time::main_clock();
         const auto time = clock->ns();
@@ -602,22 +1193,53 @@ namespace sched
         const auto self = cpu::self();
         auto &dead = pcpu.dead_threads;
 
+        const auto current = pcpu.running_thread;
+        const bool is_current_idle = (current == pcpu.idle_thread);
+        const bool is_accounted = (current && !is_current_idle && current->status != status::killed);
+
+        if (is_accounted) [[likely]]
+        {
+            const std::size_t exec_time = time - current->schedule_time;
+            current->cpu_time += exec_time;
+
+            if (current->policy == policy::other)
+            {
+                static constexpr std::size_t weight0 = prio_to_weight(0);
+                const std::size_t weight = prio_to_weight(current->priority);
+                const std::size_t vtime = (exec_time * weight0) / weight;
+                current->vruntime += vtime;
+            }
+            else
+            {
+                pcpu.rt_time += exec_time;
+                if (current->policy == policy::rr)
+                    current->rr_left -= exec_time;
+            }
+        }
+
+        if (time - pcpu.rt_period_start >= rt_period * 1'000'000)
+        {
+            pcpu.rt_period_start = time;
+            pcpu.rt_time = 0;
+        }
+        const bool throttled = (pcpu.rt_time >= rt_runtime * 1'000'000);
+
         thread *next = nullptr;
         bool found_dead = false;
+        bool preempted = false;
+        // whether current may stay on this cpu
+        bool allowed = false;
 
         {
             auto locked = pcpu.queue.lock();
 
-            const auto begin = locked->begin();
-            for (auto it = begin; it != locked->end(); )
+            const auto take = [&](thread *thread)
             {
-                const auto thread = (it++).value();
                 switch (thread->status)
                 {
                     case status::ready:
-                        next = thread;
                         locked->remove(thread);
-                        goto found;
+                        return true;
                     [[unlikely]] case status::sleeping:
                     [[unlikely]] case status::running:
                         lib::panic(
@@ -629,18 +1251,68 @@ namespace sched
                         locked->remove(thread);
                         dead.push_back(thread);
                         found_dead = true;
-                        break;
+                        return false;
                     [[unlikely]] case status::not_ready:
-                        break;
+                        return false;
                     default:
                         std::unreachable();
                 }
+            };
+
+            const auto pick_rt = [&] -> thread *
+            {
+                for (auto prio = locked->next_rt(); prio != 0; prio = locked->next_rt(prio))
+                {
+                    auto &list = locked->rt_at(prio);
+                    for (auto it = list.begin(); it != list.end(); )
+                    {
+                        const auto thread = *it++;
+                        if (take(thread))
+                            return thread;
+                    }
+                }
+                return nullptr;
+            };
+
+            const auto pick_fair = [&] -> thread *
+            {
+                for (auto it = locked->fair.begin(); it != locked->fair.end(); )
+                {
+                    const auto thread = (it++).value();
+                    if (take(thread))
+                        return thread;
+                }
+                return nullptr;
+            };
+
+            const bool yielded = current ? std::exchange(current->yielded, false) : false;
+
+            // a real-time thread keeps the cpu until it blocks, yields, runs out of
+            // its round robin quantum, gets throttled or a higher priority one shows up
+            allowed = (current && current->affinity[self->idx]);
+
+            if (is_accounted && allowed && current->policy != policy::other && current->status == status::running)
+            {
+                const bool expired = (current->policy == policy::rr && current->rr_left <= 0);
+                if (expired)
+                    current->rr_left = rr_timeslice * 1'000'000;
+
+                if (!yielded && !expired && !(throttled && !locked->fair.empty()))
+                {
+                    if (locked->next_rt() > current->rt_priority)
+                        preempted = true;
+                    else
+                        next = current;
+                }
             }
-            found:
-        }
 
-        const auto current = pcpu.running_thread;
-        const bool is_current_idle = (current == pcpu.idle_thread);
+            if (next == nullptr && !throttled)
+                next = pick_rt();
+            if (next == nullptr)
+                next = pick_fair();
+            if (next == nullptr && throttled)
+                next = pick_rt();
+        }
 
         std::optional<pid_t> prev_pid { };
         if (current) [[likely]]
@@ -650,22 +1322,26 @@ namespace sched
                 prev_pid = current->parent->pid;
                 if (!is_current_idle) [[likely]]
                 {
-                    if (next == nullptr && current->status == status::running) [[unlikely]]
+                    if (next == nullptr && allowed && current->status == status::running) [[unlikely]]
                         next = current;
-                    else if (current->status == status::sleeping)
-                        current->sleep_lock.unlock();
-
-                    static constexpr std::size_t weight0 = prio_to_weight(0);
-                    const std::size_t exec_time = time - current->schedule_time;
-                    const std::size_t weight = prio_to_weight(current->priority);
-                    const std::size_t vtime = (exec_time * weight0) / weight;
-                    current->vruntime += vtime;
 
                     if (next != current) [[likely]]
                     {
                         save(current, regs);
+                        // only now can it be woken up and picked by another cpu
+                        if (current->status == status::sleeping)
+                            current->sleep_lock.unlock();
+
+                        // preempted real-time threads go back to the head of their list.
+                        // scheduling happens on a separate stack, so a thread whose
+                        // affinity no longer includes this cpu can be handed off right away
                         if (current->status != status::sleeping)
-                            enqueue(current, self->idx);
+                        {
+                            if (allowed)
+                                requeue(current, self->idx, preempted);
+                            else
+                                requeue(current, allocate_cpu(current->affinity), false);
+                        }
                     }
                 }
                 // should it save idle thread ctx?
@@ -683,7 +1359,7 @@ namespace sched
             auto &reaper = percpu->reaper_thread;
             // if the reaper is sleeping and not waiting for a timeout
             if (reaper->status == status::sleeping && reaper->sleep_until == std::nullopt)
-                reaper->status = status::ready;
+                reaper->wake_up(wake_reason::success);
         }
 
         if (next == nullptr) [[unlikely]]
@@ -699,13 +1375,43 @@ namespace sched
             load(same_pid, next, regs);
         }
 
-        if (!is_current_idle) [[likely]]
+        if (next != pcpu.idle_thread) [[likely]]
             next->schedule_time = clock->ns();
 
         arch::reschedule(timeslice);
         pcpu.in_scheduler.store(false, std::memory_order_release);
     }
 
+    lib::initgraph::task idle_stats_task
+    {
+        "sched.idle-stats.create",
+        lib::initgraph::postsched_init_engine,
+        lib::initgraph::require { fs::procfs::mounted_stage() },
+        [] {
+            const auto ret = fs::procfs::create("cpuidle", [] {
+                std::string str;
+                fmt::format_to(
+                    std::back_inserter(str), "{:<6} {:>16} {:>12} {:>12} {:>12}\n",
+                    "cpu", "residency_us", "wakes", "polled", "monitored"
+                );
+                for (std::size_t i = 0; i < cpu::count(); i++)
+                {
+                    const auto &obj = percpu.get(cpu::local::nth_base(i));
+                    fmt::format_to(
+                        std::back_inserter(str), "{:<6} {:>16} {:>12} {:>12} {:>12}\n",
+                        fmt::format("cpu{}", i),
+                        obj.idle_time.load(std::memory_order_relaxed) / 1'000,
+                        obj.idle_wakes.load(std::memory_order_relaxed),
+                        obj.idle_poll_wakes.load(std::memory_order_relaxed),
+                        obj.idle_monitor_wakes.load(std::memory_order_relaxed)
+                    );
+                }
+                return str;
+            });
+            lib::panic_if(!ret, "sched: could not create /proc/cpuidle");
+        }
+    };
+
     lib::initgraph::stage *pid0_initialised_stage()
     {
         static lib::initgraph::stage stage
@@ -749,6 +1455,9 @@ namespace sched
         ) {
             ::arch::pause();
         }
+
+        if (expected == 1 && pcpu.need_resched.exchange(false, std::memory_order_acq_rel))
+            arch::reschedule(0);
     }
 
     void disable()
@@ -784,15 +1493,20 @@ namespace sched
         percpu->idle_thread = idle_thread;
 
         arch::init();
+        smp::init_cpu();
+        hrtimer::init_cpu();
         ::arch::int_switch(true);
 
         if (self->idx == cpu::bsp_idx())
         {
+            lib::panic_if(cpu::count() > max_cpus, "sched: more than {} cpus are not supported", max_cpus);
+
             for (std::size_t idx = 0; idx < cpu::count(); idx++)
             {
                 auto &obj = percpu.get(cpu::local::nth_base(idx));
+                // these work on the per-cpu lists of the cpu they were started on
                 obj.reaper_thread = sched::spawn_on(idx, 0, reinterpret_cast<std::uintptr_t>(reaper), nice_t::max);
-                sched::spawn_on(idx, 0, reinterpret_cast<std::uintptr_t>(sleeper), -5);
+                obj.reaper_thread->affinity = cpumask { }.set(idx);
             }
 
             initialised = true;
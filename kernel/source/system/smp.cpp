@@ -0,0 +1,203 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module system.smp;
+
+import system.scheduler;
+import system.cpu.self;
+import system.cpu;
+import arch;
+import lib;
+import cppstd;
+
+namespace smp
+{
+    namespace arch
+    {
+        // false if cross calls aren't supported
+        bool init();
+        // interrupt cpu so it runs handle()
+        void send(std::size_t cpu);
+    } // namespace arch
+
+    namespace
+    {
+        struct call
+        {
+            call *next = nullptr;
+            const std::function<void ()> *func = nullptr;
+
+            // cleared by the target once func has returned
+            std::atomic_bool locked = false;
+
+            // asynchronous calls keep their own copy and are freed by the target
+            std::function<void ()> owned;
+        };
+
+        struct percpu
+        {
+            // pushed to by any cpu, drained only by the owner
+            std::atomic<call *> queue = nullptr;
+            std::atomic_bool ready = false;
+
+            // synchronous calls made from this cpu, one entry per target
+            std::unique_ptr<call[]> sync;
+        };
+        cpu_local<percpu> local;
+        cpu_local_init(local);
+
+        percpu &nth(std::size_t idx)
+        {
+            return local.get(cpu::local::nth_base(idx));
+        }
+
+        bool can_call(std::size_t idx)
+        {
+            return cpu::nth(idx)->online.load(std::memory_order_acquire) &&
+                nth(idx).ready.load(std::memory_order_acquire);
+        }
+
+        void enqueue(std::size_t idx, call *entry)
+        {
+            auto &queue = nth(idx).queue;
+            auto head = queue.load(std::memory_order_relaxed);
+            do {
+                entry->next = head;
+            } while (!queue.compare_exchange_weak(head, entry, std::memory_order_release, std::memory_order_relaxed));
+
+            // a non-empty queue already has an ipi on the way
+            if (head == nullptr)
+                arch::send(idx);
+        }
+
+        void run_local(const std::function<void ()> &func)
+        {
+            const bool ints = ::arch::int_switch_status(false);
+            func();
+            ::arch::int_switch(ints);
+        }
+
+        void wait_for(const call &entry)
+        {
+            // keep serving our own queue so cpus calling each other can't deadlock
+            while (entry.locked.load(std::memory_order_acquire))
+            {
+                const bool ints = ::arch::int_switch_status(false);
+                handle();
+                ::arch::int_switch(ints);
+                ::arch::pause();
+            }
+        }
+
+        call &sync_entry(std::size_t idx, const std::function<void ()> &func)
+        {
+            lib::bug_on(!local->sync);
+
+            // a function we ran while waiting may have called the same cpu
+            auto &entry = local->sync[idx];
+            wait_for(entry);
+
+            entry.func = &func;
+            entry.locked.store(true, std::memory_order_relaxed);
+            return entry;
+        }
+
+        call *async_entry(std::function<void ()> func)
+        {
+            const auto entry = new call { };
+            entry->owned = std::move(func);
+            entry->func = &entry->owned;
+            return entry;
+        }
+    } // namespace
+
+    bool call_single(std::size_t cpu, std::function<void ()> func, bool wait)
+    {
+        lib::bug_on(cpu >= cpu::count());
+
+        // keeps us on this cpu and our sync entries ours
+        sched::disable();
+
+        bool ret = true;
+        if (cpu == cpu::self()->idx)
+            run_local(func);
+        else if (!can_call(cpu))
+            ret = false;
+        else if (wait)
+        {
+            auto &entry = sync_entry(cpu, func);
+            enqueue(cpu, &entry);
+            wait_for(entry);
+        }
+        else enqueue(cpu, async_entry(std::move(func)));
+
+        sched::enable();
+        return ret;
+    }
+
+    void call_many(const sched::cpumask &mask, std::function<void ()> func, bool wait)
+    {
+        sched::disable();
+
+        const auto self = cpu::self()->idx;
+        sched::cpumask queued { };
+
+        for (std::size_t idx = 0; idx < cpu::count(); idx++)
+        {
+            if (idx == self || !mask.test(idx) || !can_call(idx))
+                continue;
+
+            if (wait)
+                enqueue(idx, &sync_entry(idx, func));
+            else
+                enqueue(idx, async_entry(func));
+            queued.set(idx);
+        }
+
+        // run ours while the others are busy with theirs
+        if (mask.test(self))
+            run_local(func);
+
+        if (wait)
+        {
+            for (std::size_t idx = 0; idx < cpu::count(); idx++)
+            {
+                if (queued.test(idx))
+                    wait_for(local->sync[idx]);
+            }
+        }
+
+        sched::enable();
+    }
+
+    void handle()
+    {
+        auto list = local->queue.exchange(nullptr, std::memory_order_acquire);
+
+        // oldest first
+        call *ordered = nullptr;
+        while (list != nullptr)
+        {
+            const auto node = std::exchange(list, list->next);
+            node->next = ordered;
+            ordered = node;
+        }
+
+        while (ordered != nullptr)
+        {
+            // a finished sync entry may be reused right away, so step first
+            const auto node = std::exchange(ordered, ordered->next);
+            (*node->func)();
+
+            if (node->func == &node->owned)
+                delete node;
+            else
+                node->locked.store(false, std::memory_order_release);
+        }
+    }
+
+    void init_cpu()
+    {
+        local->sync = std::make_unique<call[]>(cpu::count());
+        local->ready.store(arch::init(), std::memory_order_release);
+    }
+} // namespace smp
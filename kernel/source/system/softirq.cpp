@@ -0,0 +1,202 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module system.softirq;
+
+import system.scheduler;
+import system.cpu.self;
+import system.cpu;
+import system.time;
+import arch;
+import lib;
+import cppstd;
+
+namespace softirq
+{
+    namespace
+    {
+        // budget for one run at interrupt exit
+        constexpr std::size_t max_restarts = 10;
+        constexpr std::size_t max_time = 2'000'000;
+
+        struct percpu
+        {
+            std::atomic_uint32_t pending = 0;
+            // set while softirqs run on this cpu, they don't nest
+            bool running = false;
+
+            sched::thread *thread = nullptr;
+
+            tasklet *tasklets = nullptr;
+        };
+        cpu_local<percpu> local;
+        cpu_local_init(local);
+
+        void run_tasklets()
+        {
+            const bool ints = arch::int_switch_status(false);
+            auto list = std::exchange(local->tasklets, nullptr);
+            arch::int_switch(ints);
+
+            while (list != nullptr)
+            {
+                auto &t = *std::exchange(list, list->next);
+
+                // still running on another cpu, try again later
+                if (t.running.exchange(true, std::memory_order_acquire))
+                {
+                    const bool ints = arch::int_switch_status(false);
+                    t.next = local->tasklets;
+                    local->tasklets = &t;
+                    local->pending.fetch_or(1u << static_cast<std::size_t>(type::tasklet), std::memory_order_release);
+                    arch::int_switch(ints);
+                    continue;
+                }
+
+                // may reschedule itself
+                t.scheduled.store(false, std::memory_order_release);
+                t.func(t.data);
+                t.running.store(false, std::memory_order_release);
+            }
+        }
+
+        constexpr auto num_types = static_cast<std::size_t>(type::max);
+        constinit auto handlers = [] {
+            std::array<handler, num_types> ret { };
+            ret[static_cast<std::size_t>(type::tasklet)] = run_tasklets;
+            return ret;
+        } ();
+
+        // interrupts are disabled
+        bool run(std::size_t restarts, std::size_t budget)
+        {
+            auto &pcpu = local.get();
+            if (pcpu.running)
+                return false;
+            pcpu.running = true;
+
+            const auto clock = time::main_clock();
+            const auto start = clock ? clock->ns() : 0;
+
+            std::size_t rounds = 0;
+            while (true)
+            {
+                auto bits = pcpu.pending.exchange(0, std::memory_order_acq_rel);
+                if (bits == 0)
+                    break;
+
+                arch::int_switch(true);
+                while (bits != 0)
+                {
+                    const auto idx = std::countr_zero(bits);
+                    bits &= bits - 1;
+                    if (const auto func = handlers[idx])
+                        func();
+                }
+                arch::int_switch(false);
+
+                if (++rounds >= restarts)
+                    break;
+                if (clock && clock->ns() - start >= budget)
+                    break;
+            }
+
+            pcpu.running = false;
+            return pcpu.pending.load(std::memory_order_relaxed) != 0;
+        }
+
+        void wake_thread()
+        {
+            if (const auto thread = local->thread)
+                thread->wake_up(0);
+        }
+
+        [[noreturn]] void softirqd()
+        {
+            const auto me = sched::this_thread();
+            while (true)
+            {
+                arch::int_switch(false);
+                if (local->pending.load(std::memory_order_acquire) == 0)
+                {
+                    // raised only from this cpu, and interrupts are off
+                    me->prepare_sleep();
+                    sched::yield();
+                    arch::int_switch(false);
+                }
+
+                sched::disable();
+                const bool more = run(max_restarts, max_time);
+                sched::enable();
+                arch::int_switch(true);
+
+                if (more)
+                    sched::yield();
+            }
+        }
+
+    } // namespace
+
+    void register_handler(type type, handler func)
+    {
+        const auto idx = static_cast<std::size_t>(type);
+        lib::bug_on(idx >= num_types);
+        lib::panic_if(handlers[idx] != nullptr, "softirq: handler {} already registered", idx);
+        handlers[idx] = func;
+    }
+
+    void raise(type type)
+    {
+        local->pending.fetch_or(1u << static_cast<std::size_t>(type), std::memory_order_release);
+
+        // nothing will run it at interrupt exit
+        if (!cpu::self()->in_interrupt.load(std::memory_order_acquire))
+            wake_thread();
+    }
+
+    bool pending()
+    {
+        if (!cpu::local::available())
+            return false;
+        return local->pending.load(std::memory_order_relaxed) != 0;
+    }
+
+    void irq_exit()
+    {
+        if (!pending())
+            return;
+
+        sched::disable();
+        const bool more = run(max_restarts, max_time);
+        sched::enable();
+
+        if (more)
+            wake_thread();
+    }
+
+    void schedule(tasklet &t)
+    {
+        if (t.scheduled.exchange(true, std::memory_order_acq_rel))
+            return;
+
+        const bool ints = arch::int_switch_status(false);
+        t.next = local->tasklets;
+        local->tasklets = &t;
+        arch::int_switch(ints);
+
+        raise(type::tasklet);
+    }
+
+    lib::initgraph::task softirqd_task
+    {
+        "softirq.threads.spawn",
+        lib::initgraph::postsched_init_engine,
+        [] {
+            for (std::size_t idx = 0; idx < cpu::count(); idx++)
+            {
+                const auto thread = sched::spawn_on(idx, 0, reinterpret_cast<std::uintptr_t>(softirqd), -5);
+                thread->affinity = sched::cpumask { }.set(idx);
+                local.get(cpu::local::nth_base(idx)).thread = thread;
+            }
+        }
+    };
+} // namespace softirq
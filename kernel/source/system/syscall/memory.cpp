@@ -4,6 +4,7 @@ module system.syscall.memory;
 
 import system.memory.virt;
 import system.scheduler;
+import system.vfs;
 import lib;
 
 import cppstd;
@@ -22,6 +23,9 @@ namespace syscall::memory
         if ((priv && shared) || (!priv && !shared) || (fd >= 0 && anon) || length == 0)
             return (errno = EINVAL, invalid_addr);
 
+        // these mapping flags are only set by the kernel
+        flags &= ~(vmm::flag::untouchable | vmm::flag::no_write);
+
         const auto psize = vmm::default_page_size();
         if (length % psize != 0 || offset % psize != 0)
             return (errno = EINVAL, invalid_addr);
@@ -62,6 +66,19 @@ namespace syscall::memory
             if (!fdesc)
                 return (errno = EBADF, invalid_addr);
 
+            // sealed memfds can't gain new writable shared mappings,
+            // not even later through mprotect
+            if (shared)
+            {
+                const auto seals = fdesc->file->get_seals();
+                if (seals > 0 && (seals & (vfs::f_seal_write | vfs::f_seal_future_write)))
+                {
+                    if (prot & vmm::prot::write)
+                        return (errno = EPERM, invalid_addr);
+                    flags |= vmm::flag::no_write;
+                }
+            }
+
             obj = fdesc->file->map(priv);
             if (!obj)
                 return (errno = ENODEV, invalid_addr);
@@ -77,10 +94,14 @@ namespace syscall::memory
             address, length,
             static_cast<std::uint8_t>(prot),
             static_cast<std::uint8_t>(flags),
-            obj, static_cast<off_t>(offset)
+            obj, static_cast<off_t>(offset),
+            vmspace->future_hints
         ))
             return (errno = ENOMEM, invalid_addr);
 
+        if (vmspace->future_hints & vmm::hint::mlocked)
+            lib::unused(vmspace->populate(address, length));
+
         return reinterpret_cast<void *>(address);
     }
 
@@ -103,6 +124,186 @@ namespace syscall::memory
             static_cast<std::uint8_t>(prot)
         );
 
-        return res ? 0 : (errno = ENOMEM, -1);
+        if (!res)
+            return (errno = (res.error() == vmm::error::not_permitted ? EACCES : ENOMEM), -1);
+        return 0;
+    }
+
+    void *mremap(void *old_address, std::size_t old_size, std::size_t new_size, int flags, void *new_address)
+    {
+        static void *invalid_addr = reinterpret_cast<void *>(-1);
+
+        const bool may_move = (flags & 1); // MREMAP_MAYMOVE
+        const bool fixed = (flags & 2); // MREMAP_FIXED
+
+        if ((flags & ~3) || (fixed && !may_move) || new_size == 0)
+            return (errno = EINVAL, invalid_addr);
+
+        // duplicating shared mappings is not supported
+        if (old_size == 0)
+            return (errno = EINVAL, invalid_addr);
+
+        const auto proc = sched::this_thread()->parent;
+        const auto &vmspace = proc->vmspace;
+
+        const auto res = vmspace->remap(
+            reinterpret_cast<std::uintptr_t>(old_address), old_size, new_size, may_move,
+            fixed ? reinterpret_cast<std::uintptr_t>(new_address) : 0
+        );
+        if (!res)
+        {
+            switch (res.error())
+            {
+                case vmm::error::not_mapped:
+                    return (errno = EFAULT, invalid_addr);
+                case vmm::error::addr_in_use:
+                    return (errno = ENOMEM, invalid_addr);
+                default:
+                    return (errno = EINVAL, invalid_addr);
+            }
+        }
+
+        return reinterpret_cast<void *>(res.value());
+    }
+
+    int madvise(void *addr, std::size_t length, int advice)
+    {
+        const auto proc = sched::this_thread()->parent;
+        const auto &vmspace = proc->vmspace;
+
+        const auto address = reinterpret_cast<std::uintptr_t>(addr);
+        const auto psize = vmm::default_page_size();
+        if (address % psize)
+            return (errno = EINVAL, -1);
+
+        if (length == 0)
+            return 0;
+
+        length = lib::align_up(length, psize);
+        if (!vmspace->is_mapped(address, length))
+            return (errno = ENOMEM, -1);
+
+        std::expected<void, vmm::error> res;
+        switch (advice)
+        {
+            case 0: // MADV_NORMAL
+            case 1: // MADV_RANDOM
+                res = vmspace->set_hints(address, length, 0, vmm::hint::sequential);
+                break;
+            case 2: // MADV_SEQUENTIAL
+                res = vmspace->set_hints(address, length, vmm::hint::sequential, 0);
+                break;
+            case 3: // MADV_WILLNEED
+                res = vmspace->prefetch(address, length);
+                break;
+            case 4: // MADV_DONTNEED
+            case 8: // MADV_FREE
+                // there is no reclaim to defer to, so MADV_FREE drops the pages right away
+                res = vmspace->discard(address, length);
+                break;
+            case 14: // MADV_HUGEPAGE
+                res = vmspace->set_hints(address, length, vmm::hint::hugepage, 0);
+                break;
+            case 15: // MADV_NOHUGEPAGE
+                res = vmspace->set_hints(address, length, 0, vmm::hint::hugepage);
+                break;
+            default:
+                return (errno = EINVAL, -1);
+        }
+
+        return res ? 0 : (errno = EINVAL, -1);
+    }
+
+    int mlock(const void *addr, std::size_t len)
+    {
+        const auto proc = sched::this_thread()->parent;
+        const auto &vmspace = proc->vmspace;
+
+        const auto psize = vmm::default_page_size();
+        const auto address = lib::align_down(reinterpret_cast<std::uintptr_t>(addr), psize);
+        len = lib::align_up(len + (reinterpret_cast<std::uintptr_t>(addr) - address), psize);
+
+        if (len == 0)
+            return 0;
+
+        if (!vmspace->is_mapped(address, len))
+            return (errno = ENOMEM, -1);
+
+        if (!vmspace->set_hints(address, len, vmm::hint::mlocked, 0) || !vmspace->populate(address, len))
+            return (errno = ENOMEM, -1);
+
+        return 0;
+    }
+
+    int munlock(const void *addr, std::size_t len)
+    {
+        const auto proc = sched::this_thread()->parent;
+        const auto &vmspace = proc->vmspace;
+
+        const auto psize = vmm::default_page_size();
+        const auto address = lib::align_down(reinterpret_cast<std::uintptr_t>(addr), psize);
+        len = lib::align_up(len + (reinterpret_cast<std::uintptr_t>(addr) - address), psize);
+
+        if (len == 0)
+            return 0;
+
+        if (!vmspace->is_mapped(address, len))
+            return (errno = ENOMEM, -1);
+
+        return vmspace->set_hints(address, len, 0, vmm::hint::mlocked) ? 0 : (errno = ENOMEM, -1);
+    }
+
+    int mlockall(int flags)
+    {
+        const bool current = (flags & 1); // MCL_CURRENT
+        const bool future = (flags & 2); // MCL_FUTURE
+        const bool onfault = (flags & 4); // MCL_ONFAULT
+
+        if ((flags & ~7) || (!current && !future))
+            return (errno = EINVAL, -1);
+
+        const auto proc = sched::this_thread()->parent;
+        const auto &vmspace = proc->vmspace;
+
+        if (future)
+            vmspace->future_hints |= vmm::hint::mlocked;
+
+        if (current)
+        {
+            if (!vmspace->set_hints(vmm::hint::mlocked, 0))
+                return (errno = ENOMEM, -1);
+
+            if (!onfault)
+            {
+                std::vector<std::pair<std::uintptr_t, std::size_t>> ranges;
+                {
+                    const auto psize = vmm::default_page_size();
+                    const auto locked = vmspace->tree.read_lock();
+                    for (const auto &entry : *locked)
+                    {
+                        if (entry.flags & vmm::flag::untouchable)
+                            continue;
+                        ranges.emplace_back(entry.startp * psize, (entry.endp - entry.startp) * psize);
+                    }
+                }
+
+                for (const auto &[address, length] : ranges)
+                {
+                    if (!vmspace->populate(address, length))
+                        return (errno = ENOMEM, -1);
+                }
+            }
+        }
+
+        return 0;
+    }
+
+    int munlockall()
+    {
+        const auto proc = sched::this_thread()->parent;
+        const auto &vmspace = proc->vmspace;
+
+        vmspace->future_hints &= ~vmm::hint::mlocked;
+        return vmspace->set_hints(0, vmm::hint::mlocked) ? 0 : (errno = ENOMEM, -1);
     }
 } // namespace syscall::memory
\ No newline at end of file
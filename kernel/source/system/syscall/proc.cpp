@@ -3,6 +3,10 @@
 module system.syscall.proc;
 
 import system.scheduler;
+import system.rcu;
+import system.time;
+import system.vfs;
+import system.cpu;
 import lib;
 import cppstd;
 
@@ -174,27 +178,94 @@ namespace syscall::proc
 
         int pselect(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, timespec *timeout, bool update_timeout, const sigset_t *sigmask)
         {
-            auto count_bits = [](const fd_set *set) -> std::size_t
-            {
-                if (set == nullptr)
-                    return 0;
+            // TODO: there are no signals to mask yet
+            lib::unused(sigmask, FD_CLR);
 
-                std::size_t count = 0;
-                for (std::size_t i = 0; i < sizeof(set->fds_bits); i++)
-                    count += std::popcount(set->fds_bits[i]);
-                return count;
-            };
+            if (nfds < 0 || nfds > FD_SETSIZE)
+                return (errno = EINVAL, -1);
+            if (timeout && (timeout->tv_sec < 0 || timeout->tv_nsec < 0 || timeout->tv_nsec >= 1'000'000'000))
+                return (errno = EINVAL, -1);
 
-            // TODO
-            lib::unused(nfds, timeout, update_timeout, sigmask);
-            lib::unused(FD_CLR, FD_ISSET, FD_SET, FD_ZERO);
+            const auto proc = sched::this_thread()->parent;
+            const auto clock = ::time::main_clock();
+            const auto deadline = timeout ? clock->ns() + timeout->to_ns() : 0;
 
-            const int total_fds =
-                count_bits(readfds) +
-                count_bits(writefds) +
-                count_bits(exceptfds);
+            struct polled
+            {
+                int fd;
+                bool r, w, e;
+                std::shared_ptr<vfs::file> file;
+            };
+            std::vector<polled> files;
 
-            return total_fds;
+            for (int fd = 0; fd < nfds; fd++)
+            {
+                const bool r = readfds && FD_ISSET(fd, readfds);
+                const bool w = writefds && FD_ISSET(fd, writefds);
+                const bool e = exceptfds && FD_ISSET(fd, exceptfds);
+                if (!r && !w && !e)
+                    continue;
+
+                const auto fdesc = proc->fdt.get(fd);
+                if (fdesc == nullptr)
+                    return (errno = EBADF, -1);
+                files.emplace_back(fd, r, w, e, fdesc->file);
+            }
+
+            // queued before the first poll, so nothing that becomes ready
+            // after it is missed
+            vfs::poll_waiter waiter;
+            for (const auto &entry : files)
+                entry.file->pollers.add(&waiter);
+
+            fd_set rset, wset, eset;
+            int ready = 0;
+            std::uint64_t now;
+            while (true)
+            {
+                FD_ZERO(&rset);
+                FD_ZERO(&wset);
+                FD_ZERO(&eset);
+
+                ready = 0;
+                for (const auto &entry : files)
+                {
+                    const auto events = entry.file->poll();
+                    const auto mark = [&ready, fd = entry.fd](bool wanted, bool is_ready, fd_set *set) {
+                        if (wanted && is_ready)
+                        {
+                            FD_SET(fd, set);
+                            ready++;
+                        }
+                    };
+                    mark(entry.r, events & (vfs::pollin | vfs::pollhup | vfs::pollerr), &rset);
+                    mark(entry.w, events & (vfs::pollout | vfs::pollerr), &wset);
+                    mark(entry.e, events & vfs::pollpri, &eset);
+                }
+
+                now = clock->ns();
+                if (ready != 0 || (timeout && now >= deadline))
+                    break;
+
+                if (timeout)
+                    waiter.wake.wait_for_ns(deadline - now);
+                else
+                    waiter.wake.wait();
+            }
+
+            for (const auto &entry : files)
+                entry.file->pollers.remove(&waiter);
+
+            if (readfds)
+                *readfds = rset;
+            if (writefds)
+                *writefds = wset;
+            if (exceptfds)
+                *exceptfds = eset;
+
+            if (timeout && update_timeout)
+                *timeout = timespec { now < deadline ? deadline - now : 0 };
+            return ready;
         }
 
         int pselect(int nfds, fd_set __user *readfds, fd_set __user *writefds, fd_set __user *exceptfds, timespec *timeout, bool update_timeout, const sigset_t __user *sigmask)
@@ -231,11 +302,16 @@ namespace syscall::proc
         if (ktimeval.has_value())
             ktimeout.emplace(ktimeval.value());
 
-        return pselect(
+        const auto ret = pselect(
             nfds, readfds, writefds, exceptfds,
             ktimeout ? &ktimeout.value() : nullptr,
             (timeout != nullptr), nullptr
         );
+
+        // linux writes back the time that was left
+        if (ret >= 0 && ktimeout.has_value())
+            copy_to(timeout, ktimeout->to_timeval());
+        return ret;
     }
 
     int pselect(int nfds, fd_set __user *readfds, fd_set __user *writefds, fd_set __user *exceptfds, const timespec __user *timeout, const sigset_t __user *sigmask)
@@ -248,6 +324,294 @@ namespace syscall::proc
         );
     }
 
+    struct sched_param
+    {
+        int sched_priority;
+    };
+
+    namespace
+    {
+        constexpr int SCHED_OTHER = 0;
+        constexpr int SCHED_FIFO = 1;
+        constexpr int SCHED_RR = 2;
+        constexpr int SCHED_RESET_ON_FORK = 0x40000000;
+
+        std::optional<sched::policy> to_policy(int policy)
+        {
+            switch (policy)
+            {
+                case SCHED_OTHER:
+                    return sched::policy::other;
+                case SCHED_FIFO:
+                    return sched::policy::fifo;
+                case SCHED_RR:
+                    return sched::policy::rr;
+                default:
+                    return std::nullopt;
+            }
+        }
+
+        bool valid_priority(sched::policy policy, int prio)
+        {
+            if (policy == sched::policy::other)
+                return prio == 0;
+            return prio >= static_cast<int>(sched::rt_prio_min) &&
+                prio <= static_cast<int>(sched::rt_prio_max);
+        }
+
+        // threads do not have globally unique ids yet,
+        // so a non-zero pid refers to the main thread of that process.
+        // the thread is only valid inside func. the reaper takes threads out
+        // of their process and waits for a grace period before freeing them
+        template<typename Func>
+        auto with_thread(pid_t pid, Func &&func) -> std::optional<std::invoke_result_t<Func, sched::thread *>>
+        {
+            const auto me = sched::this_thread();
+            if (pid == 0)
+                return func(me);
+
+            {
+                const rcu::guard _;
+
+                const auto proc = sched::proc_for(pid);
+                if (!proc)
+                    return std::nullopt;
+
+                sched::thread *target = nullptr;
+                {
+                    const std::unique_lock _ { proc->lock };
+                    for (const auto &[tid, thread] : proc->threads)
+                    {
+                        if (!target || tid < target->tid)
+                            target = thread;
+                    }
+                }
+
+                if (target == nullptr)
+                    return std::nullopt;
+                if (target != me)
+                    return func(target);
+            }
+
+            // we can't go away under ourselves, and func may sleep
+            return func(me);
+        }
+
+        bool may_set(sched::thread *target, sched::policy policy)
+        {
+            const auto proc = sched::this_thread()->parent;
+            if (proc->euid == 0)
+                return true;
+            if (policy != sched::policy::other)
+                return false;
+            const auto tproc = target->parent;
+            return tproc->ruid == proc->euid || tproc->euid == proc->euid;
+        }
+
+        int setscheduler(pid_t pid, std::optional<int> policy, const sched_param __user *param)
+        {
+            if (pid < 0 || param == nullptr)
+                return (errno = EINVAL, -1);
+
+            const auto kparam = copy_from(param).value();
+            const auto ret = with_thread(pid, [&](sched::thread *target) -> int {
+                const auto kpolicy = policy.has_value() ? to_policy(policy.value()) : target->policy;
+                if (!kpolicy.has_value() || !valid_priority(kpolicy.value(), kparam.sched_priority))
+                    return EINVAL;
+
+                if (!may_set(target, kpolicy.value()))
+                    return EPERM;
+
+                sched::set_policy(target, kpolicy.value(), kparam.sched_priority);
+                return 0;
+            });
+
+            if (!ret.has_value())
+                return (errno = ESRCH, -1);
+            if (ret.value() != 0)
+                return (errno = ret.value(), -1);
+            return 0;
+        }
+    } // namespace
+
+    int sched_yield()
+    {
+        sched::yield();
+        return 0;
+    }
+
+    int sched_setparam(pid_t pid, const sched_param __user *param)
+    {
+        return setscheduler(pid, std::nullopt, param);
+    }
+
+    int sched_getparam(pid_t pid, sched_param __user *param)
+    {
+        if (pid < 0 || param == nullptr)
+            return (errno = EINVAL, -1);
+
+        const auto prio = with_thread(pid, [](sched::thread *target) {
+            return static_cast<int>(target->rt_priority);
+        });
+        if (!prio.has_value())
+            return (errno = ESRCH, -1);
+
+        copy_to(param, sched_param { prio.value() });
+        return 0;
+    }
+
+    int sched_setscheduler(pid_t pid, int policy, const sched_param __user *param)
+    {
+        // nothing forks yet
+        policy &= ~SCHED_RESET_ON_FORK;
+        return setscheduler(pid, policy, param);
+    }
+
+    int sched_getscheduler(pid_t pid)
+    {
+        if (pid < 0)
+            return (errno = EINVAL, -1);
+
+        const auto policy = with_thread(pid, [](sched::thread *target) {
+            return target->policy;
+        });
+        if (!policy.has_value())
+            return (errno = ESRCH, -1);
+
+        return std::to_underlying(policy.value());
+    }
+
+    int sched_get_priority_max(int policy)
+    {
+        const auto kpolicy = to_policy(policy);
+        if (!kpolicy.has_value())
+            return (errno = EINVAL, -1);
+        return kpolicy.value() == sched::policy::other ? 0 : static_cast<int>(sched::rt_prio_max);
+    }
+
+    int sched_get_priority_min(int policy)
+    {
+        const auto kpolicy = to_policy(policy);
+        if (!kpolicy.has_value())
+            return (errno = EINVAL, -1);
+        return kpolicy.value() == sched::policy::other ? 0 : static_cast<int>(sched::rt_prio_min);
+    }
+
+    int sched_rr_get_interval(pid_t pid, timespec __user *tp)
+    {
+        if (pid < 0 || tp == nullptr)
+            return (errno = EINVAL, -1);
+
+        const auto policy = with_thread(pid, [](sched::thread *target) {
+            return target->policy;
+        });
+        if (!policy.has_value())
+            return (errno = ESRCH, -1);
+
+        std::uint64_t ms = 0;
+        switch (policy.value())
+        {
+            case sched::policy::other:
+                ms = sched::timeslice;
+                break;
+            case sched::policy::rr:
+                ms = sched::rr_timeslice;
+                break;
+            case sched::policy::fifo:
+                break;
+        }
+        copy_to(tp, timespec { ms * 1'000'000 });
+        return 0;
+    }
+
+    namespace
+    {
+        constexpr std::size_t mask_bits = sizeof(unsigned long) * 8;
+
+        // size of the cpu mask userspace gets back
+        std::size_t cpumask_size()
+        {
+            return lib::div_roundup(cpu::count(), mask_bits) * sizeof(unsigned long);
+        }
+    } // namespace
+
+    int sched_setaffinity(pid_t pid, std::size_t cpusetsize, const unsigned long __user *mask)
+    {
+        if (pid < 0 || mask == nullptr)
+            return (errno = EINVAL, -1);
+
+        // bits past the cpus we support are ignored
+        std::array<unsigned long, sched::max_cpus / mask_bits> words { };
+        lib::copy_from_user(words.data(), mask, std::min(cpusetsize, sizeof(words)));
+
+        sched::cpumask kmask { };
+        for (std::size_t i = 0; i < sched::max_cpus; i++)
+        {
+            if (words[i / mask_bits] & (1ul << (i % mask_bits)))
+                kmask.set(i);
+        }
+        kmask &= sched::online_cpus();
+
+        if (kmask.none())
+            return (errno = EINVAL, -1);
+
+        const auto ret = with_thread(pid, [&kmask](sched::thread *target) {
+            if (!may_set(target, sched::policy::other))
+                return false;
+            sched::set_affinity(target, kmask);
+            return true;
+        });
+
+        if (!ret.has_value())
+            return (errno = ESRCH, -1);
+        if (!ret.value())
+            return (errno = EPERM, -1);
+        return 0;
+    }
+
+    int sched_getaffinity(pid_t pid, std::size_t cpusetsize, unsigned long __user *mask)
+    {
+        if (pid < 0 || mask == nullptr)
+            return (errno = EINVAL, -1);
+
+        const auto size = cpumask_size();
+        if (cpusetsize < size || cpusetsize % sizeof(unsigned long) != 0)
+            return (errno = EINVAL, -1);
+
+        const auto affinity = with_thread(pid, [](sched::thread *target) {
+            return target->affinity;
+        });
+        if (!affinity.has_value())
+            return (errno = ESRCH, -1);
+
+        const auto kmask = affinity.value() & sched::online_cpus();
+
+        std::array<unsigned long, sched::max_cpus / mask_bits> words { };
+        for (std::size_t i = 0; i < cpu::count(); i++)
+        {
+            if (kmask[i])
+                words[i / mask_bits] |= (1ul << (i % mask_bits));
+        }
+
+        lib::copy_to_user(mask, words.data(), size);
+        return static_cast<int>(size);
+    }
+
+    int getcpu(unsigned __user *cpu, unsigned __user *node, void __user *unused)
+    {
+        lib::unused(unused);
+
+        // the value is stale as soon as we return anyway
+        const auto idx = static_cast<unsigned>(cpu::self()->idx);
+        const unsigned zero = 0;
+
+        if (cpu != nullptr)
+            lib::copy_to_user(cpu, &idx, sizeof(idx));
+        if (node != nullptr)
+            lib::copy_to_user(node, &zero, sizeof(zero));
+        return 0;
+    }
+
     long futex(std::uint32_t __user *uaddr, int futex_op, std::uint32_t val, const timespec __user *timeout, std::uint32_t __user *uaddr2, std::uint32_t val3)
     {
         lib::unused(uaddr, futex_op, val, timeout, uaddr2, val3);
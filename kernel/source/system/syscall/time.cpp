@@ -2,16 +2,862 @@
 
 module system.syscall.time;
 
+import drivers.fs.tmpfs;
+import system.scheduler;
+import system.memory.virt;
+import system.hrtimer;
+import system.softirq;
 import system.time;
+import system.vfs;
+import frigg;
 import lib;
 import cppstd;
 
 namespace syscall::time
 {
+    struct itimerspec
+    {
+        timespec it_interval;
+        timespec it_value;
+    };
+
+    struct itimerval
+    {
+        timeval it_interval;
+        timeval it_value;
+    };
+
+    struct sigevent
+    {
+        std::uintptr_t sigev_value;
+        int sigev_signo;
+        int sigev_notify;
+        int pad[12];
+    };
+    static_assert(sizeof(sigevent) == 64);
+
+    namespace
+    {
+        constexpr int timer_abstime = 1;
+
+        // includes the current slice if thread is running right now
+        std::uint64_t cpu_time_of(const sched::thread *thread)
+        {
+            auto ns = thread->cpu_time;
+            if (thread == sched::this_thread())
+                ns += ::time::main_clock()->ns() - thread->schedule_time;
+            return ns;
+        }
+
+        std::optional<std::uint64_t> clock_ns(clockid_t clockid)
+        {
+            if (clockid == ::time::thread_cputime)
+                return cpu_time_of(sched::this_thread());
+
+            if (clockid == ::time::process_cputime)
+            {
+                // threads that have exited aren't counted
+                const auto proc = sched::this_thread()->parent;
+                const std::unique_lock _ { proc->lock };
+
+                std::uint64_t ns = 0;
+                for (const auto &[tid, thread] : proc->threads)
+                    ns += cpu_time_of(thread);
+                return ns;
+            }
+
+            if (!::time::is_valid(clockid))
+                return std::nullopt;
+            return ::time::ns(clockid);
+        }
+
+        bool is_valid(const timespec &ts)
+        {
+            return ts.tv_sec >= 0 && ts.tv_nsec >= 0 && ts.tv_nsec < 1'000'000'000;
+        }
+
+        // sleeps on the main clock, returns the time left if interrupted
+        std::uint64_t sleep_ns(std::uint64_t ns)
+        {
+            const auto clock = ::time::main_clock();
+            const auto target = clock->ns() + ns;
+
+            if (sched::sleep_for_ns(ns) != sched::wake_reason::interrupted)
+                return 0;
+
+            const auto now = clock->ns();
+            return now < target ? target - now : 0;
+        }
+
+        // something waiting for an absolute CLOCK_REALTIME deadline, which
+        // has to move when the clock is stepped
+        struct realtime_waiter
+        {
+            frg::default_list_hook<realtime_waiter> hook;
+
+            // from clock_settime, with realtime_waiters locked
+            virtual void clock_was_set() = 0;
+
+            protected:
+            ~realtime_waiter() = default;
+        };
+
+        lib::locker<
+            frg::intrusive_list<
+                realtime_waiter,
+                frg::locate_member<
+                    realtime_waiter,
+                    frg::default_list_hook<realtime_waiter>,
+                    &realtime_waiter::hook
+                >
+            >, lib::mutex
+        > realtime_waiters;
+
+        // an absolute CLOCK_REALTIME clock_nanosleep
+        struct realtime_sleep : realtime_waiter
+        {
+            // signalled to make the sleeper look at the clock again
+            lib::semaphore stepped;
+
+            void clock_was_set() override
+            {
+                stepped.signal();
+            }
+        };
+
+        // sleeps until clockid reaches deadline
+        void sleep_until(clockid_t clockid, std::uint64_t deadline)
+        {
+            realtime_sleep entry;
+            const bool follow = (clockid == ::time::realtime);
+            if (follow)
+                realtime_waiters.lock()->push_back(&entry);
+
+            // sleeps are on the main clock, which the others drift away from
+            while (true)
+            {
+                const auto now = ::time::ns(clockid);
+                if (now >= deadline)
+                    break;
+
+                if (follow)
+                    entry.stepped.wait_for_ns(deadline - now);
+                else
+                    sched::sleep_for_ns(deadline - now);
+            }
+
+            if (follow)
+            {
+                auto locked = realtime_waiters.lock();
+                locked->erase(locked->iterator_to(&entry));
+            }
+        }
+
+        // a one-shot or periodic timer, counts expirations until someone
+        // consumes them. it_value and it_interval are kept in ns
+        class interval_timer : public realtime_waiter
+        {
+            private:
+            hrtimer::timer _timer;
+            bool _armed = false;
+
+            // CLOCK_REALTIME time of the next expiry for absolute realtime timers
+            std::optional<std::uint64_t> _deadline;
+            // on realtime_waiters, protected by its lock
+            bool _listed = false;
+
+            void expire()
+            {
+                const std::unique_lock _ { lock };
+                // clock_was_set() moved it while this was waiting for the lock
+                if (!_armed || _timer.pending())
+                    return;
+
+                // catch up on the periods we were late for
+                std::uint64_t count = 1;
+                if (interval != 0)
+                {
+                    const auto now = ::time::main_clock()->ns();
+                    if (now > _timer.expires)
+                        count += (now - _timer.expires) / interval;
+                    hrtimer::arm(_timer, _timer.expires + count * interval);
+                    if (_deadline.has_value())
+                        _deadline.value() += count * interval;
+                }
+                else _armed = false;
+
+                expirations += count;
+                overrun = count - 1;
+                expired();
+            }
+
+            protected:
+            // with lock held, from the timer interrupt
+            virtual void expired() { }
+
+            public:
+            const clockid_t clockid;
+
+            lib::spinlock_irq lock;
+            std::uint64_t interval = 0;
+            std::uint64_t expirations = 0;
+            // periods the last expiry was late by
+            std::uint64_t overrun = 0;
+
+            interval_timer(clockid_t clockid)
+                : _timer { [this] { expire(); } }, clockid { clockid } { }
+
+            virtual ~interval_timer()
+            {
+                disarm();
+            }
+
+            void listen()
+            {
+                auto locked = realtime_waiters.lock();
+                if (!std::exchange(_listed, true))
+                    locked->push_back(this);
+            }
+
+            void disarm()
+            {
+                {
+                    const std::unique_lock _ { lock };
+                    _armed = false;
+                    _deadline = std::nullopt;
+                }
+                // the callback takes lock, so it can't be held here
+                hrtimer::cancel(_timer);
+
+                auto locked = realtime_waiters.lock();
+                if (std::exchange(_listed, false))
+                    locked->erase(locked->iterator_to(this));
+            }
+
+            // value is relative to now, 0 disarms. deadline is the absolute
+            // CLOCK_REALTIME expiry the timer has to follow across clock steps
+            void set(std::uint64_t value, std::uint64_t new_interval, std::optional<std::uint64_t> deadline = std::nullopt)
+            {
+                disarm();
+
+                {
+                    const std::unique_lock _ { lock };
+                    interval = new_interval;
+                    expirations = 0;
+                    overrun = 0;
+
+                    if (value == 0)
+                        return;
+
+                    _armed = true;
+                    _deadline = deadline;
+                    hrtimer::arm(_timer, ::time::main_clock()->ns() + value);
+                }
+
+                if (deadline.has_value())
+                    listen();
+            }
+
+            void clock_was_set() override
+            {
+                const std::unique_lock _ { lock };
+                if (!_armed || !_deadline.has_value())
+                    return;
+
+                const auto now = ::time::ns(::time::realtime);
+                const auto left = _deadline.value() > now ? _deadline.value() - now : 1;
+                hrtimer::arm(_timer, ::time::main_clock()->ns() + left);
+            }
+
+            // time left and interval
+            std::pair<std::uint64_t, std::uint64_t> get()
+            {
+                const std::unique_lock _ { lock };
+                if (!_armed)
+                    return { 0, interval };
+
+                const auto now = ::time::main_clock()->ns();
+                const auto expires = _timer.expires;
+                // 0 would read as disarmed
+                return { expires > now ? expires - now : 1, interval };
+            }
+        };
+
+        bool is_valid_timer_clock(clockid_t clockid)
+        {
+            switch (clockid)
+            {
+                case ::time::realtime:
+                case ::time::monotonic:
+                case ::time::boottime:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        // time from now until value on clockid
+        std::uint64_t relative_ns(clockid_t clockid, const timespec &value, bool absolute)
+        {
+            const auto ns = static_cast<std::uint64_t>(value.to_ns());
+            if (!absolute)
+                return ns;
+
+            const auto now = ::time::ns(clockid);
+            // already passed, fire right away
+            return ns > now ? ns - now : 1;
+        }
+
+        std::optional<itimerspec> copy_itimerspec(const itimerspec __user *uspec)
+        {
+            itimerspec spec;
+            lib::copy_from_user(&spec, uspec, sizeof(itimerspec));
+            if (!is_valid(spec.it_value) || !is_valid(spec.it_interval))
+                return std::nullopt;
+            return spec;
+        }
+
+        void set_from(interval_timer &timer, const itimerspec &spec, bool absolute)
+        {
+            const bool disarm = (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0);
+
+            std::optional<std::uint64_t> deadline { };
+            if (absolute && timer.clockid == ::time::realtime)
+                deadline = static_cast<std::uint64_t>(spec.it_value.to_ns());
+
+            timer.set(
+                disarm ? 0 : relative_ns(timer.clockid, spec.it_value, absolute),
+                static_cast<std::uint64_t>(spec.it_interval.to_ns()),
+                deadline
+            );
+        }
+
+        itimerspec to_itimerspec(interval_timer &timer)
+        {
+            const auto [value, interval] = timer.get();
+            return itimerspec { timespec { interval }, timespec { value } };
+        }
+
+        struct timerfd : interval_timer
+        {
+            // readers sleeping in read()
+            lib::semaphore readers;
+            std::size_t waiting = 0;
+
+            // select() calls on the file this timer belongs to, which outlives it
+            vfs::poll_queue &pollers;
+
+            // TFD_TIMER_CANCEL_ON_SET, read() fails with ECANCELED once the
+            // wall clock is stepped
+            bool cancel_on_set = false;
+            bool cancelled = false;
+
+            // expired() runs in the timer interrupt, readers and select() calls
+            // are woken from here
+            softirq::tasklet wake;
+
+            timerfd(clockid_t clockid, vfs::poll_queue &pollers)
+                : interval_timer { clockid }, pollers { pollers },
+                  wake { wake_readers, reinterpret_cast<std::uintptr_t>(this) } { }
+
+            ~timerfd()
+            {
+                // the base destructor runs after readers is gone
+                disarm();
+                while (wake.scheduled.load(std::memory_order_acquire) || wake.running.load(std::memory_order_acquire))
+                    sched::yield();
+            }
+
+            static void wake_readers(std::uintptr_t data)
+            {
+                auto tfd = reinterpret_cast<timerfd *>(data);
+
+                std::size_t count;
+                {
+                    const std::unique_lock _ { tfd->lock };
+                    count = std::exchange(tfd->waiting, 0);
+                }
+                for (; count > 0; count--)
+                    tfd->readers.signal();
+                tfd->pollers.notify();
+            }
+
+            void expired() override
+            {
+                if (waiting > 0 || !pollers.empty())
+                    softirq::schedule(wake);
+            }
+
+            void clock_was_set() override
+            {
+                interval_timer::clock_was_set();
+                {
+                    const std::unique_lock _ { lock };
+                    if (!cancel_on_set)
+                        return;
+                    cancelled = true;
+                }
+                wake_readers(reinterpret_cast<std::uintptr_t>(this));
+            }
+        };
+
+        struct timerfd_ops : vfs::ops
+        {
+            static std::shared_ptr<timerfd_ops> singleton()
+            {
+                static auto instance = std::make_shared<timerfd_ops>();
+                return instance;
+            }
+
+            static std::shared_ptr<timerfd> of(const std::shared_ptr<vfs::file> &file)
+            {
+                return std::static_pointer_cast<timerfd>(file->private_data);
+            }
+
+            std::ssize_t read(std::shared_ptr<vfs::file> file, std::uint64_t offset, std::span<std::byte> buffer) override
+            {
+                lib::unused(offset);
+                if (buffer.size() < sizeof(std::uint64_t))
+                    return (errno = EINVAL, -1);
+
+                const auto tfd = of(file);
+                while (true)
+                {
+                    tfd->lock.lock();
+                    if (std::exchange(tfd->cancelled, false))
+                    {
+                        tfd->lock.unlock();
+                        return (errno = ECANCELED, -1);
+                    }
+
+                    if (const auto count = std::exchange(tfd->expirations, 0))
+                    {
+                        tfd->lock.unlock();
+                        std::memcpy(buffer.data(), &count, sizeof(count));
+                        return sizeof(count);
+                    }
+
+                    if (file->flags & vfs::o_nonblock)
+                    {
+                        tfd->lock.unlock();
+                        return (errno = EAGAIN, -1);
+                    }
+
+                    tfd->waiting++;
+                    tfd->lock.unlock();
+                    tfd->readers.wait();
+                }
+            }
+
+            std::ssize_t write(std::shared_ptr<vfs::file> file, std::uint64_t offset, std::span<std::byte> buffer) override
+            {
+                lib::unused(file, offset, buffer);
+                return (errno = EINVAL, -1);
+            }
+
+            bool trunc(std::shared_ptr<vfs::file> file, std::size_t size) override
+            {
+                lib::unused(file, size);
+                return false;
+            }
+
+            std::shared_ptr<vmm::object> map(std::shared_ptr<vfs::file> file, bool priv) override
+            {
+                lib::unused(file, priv);
+                return nullptr;
+            }
+
+            int poll(std::shared_ptr<vfs::file> file) override
+            {
+                const auto tfd = of(file);
+                const std::unique_lock _ { tfd->lock };
+                return (tfd->expirations != 0 || tfd->cancelled) ? vfs::pollin : 0;
+            }
+
+            bool sync() override { return true; }
+        };
+
+        std::shared_ptr<timerfd> get_timerfd(int fd)
+        {
+            if (fd < 0)
+                return (errno = EBADF, nullptr);
+
+            const auto fdesc = sched::this_thread()->parent->fdt.get(fd);
+            if (fdesc == nullptr)
+                return (errno = EBADF, nullptr);
+
+            const auto &file = fdesc->file;
+            if (file->get_ops() != timerfd_ops::singleton())
+                return (errno = EINVAL, nullptr);
+            return timerfd_ops::of(file);
+        }
+
+        // SIGALRM and posix timer signals need signals, which don't exist
+        // yet. their expirations are only counted for now
+        struct process_timers
+        {
+            lib::mutex lock;
+            lib::map::flat_hash<int, std::unique_ptr<interval_timer>> posix;
+            int next_id = 0;
+
+            interval_timer real { ::time::realtime };
+        };
+
+        process_timers &timers_of(sched::process *proc)
+        {
+            const std::unique_lock _ { proc->lock };
+            if (!proc->timers)
+                proc->timers = std::make_shared<process_timers>();
+            return *std::static_pointer_cast<process_timers>(proc->timers);
+        }
+
+        constexpr int sigev_signal = 0;
+        constexpr int sigev_none = 1;
+
+        constexpr int tfd_timer_abstime = 1;
+        constexpr int tfd_timer_cancel_on_set = 2;
+
+        constexpr int itimer_real = 0;
+    } // namespace
+
     int clock_gettime(clockid_t clockid, timespec __user *tp)
     {
-        const auto now = ::time::now(clockid);
+        const auto ns = clock_ns(clockid);
+        if (!ns.has_value())
+            return (errno = EINVAL, -1);
+
+        const timespec now { ns.value() };
         lib::copy_to_user(tp, &now, sizeof(timespec));
         return 0;
     }
-} // namespace syscall::time
\ No newline at end of file
+
+    int clock_settime(clockid_t clockid, const timespec __user *tp)
+    {
+        if (!::time::is_valid(clockid))
+            return (errno = EINVAL, -1);
+
+        timespec ts;
+        lib::copy_from_user(&ts, tp, sizeof(timespec));
+        if (!is_valid(ts))
+            return (errno = EINVAL, -1);
+
+        // only the wall clock can be stepped
+        if (clockid != ::time::realtime)
+            return (errno = EINVAL, -1);
+        if (sched::this_thread()->parent->euid != 0)
+            return (errno = EPERM, -1);
+
+        ::time::set_realtime(ts);
+
+        auto locked = realtime_waiters.lock();
+        for (const auto waiter : *locked)
+            waiter->clock_was_set();
+        return 0;
+    }
+
+    int clock_getres(clockid_t clockid, timespec __user *res)
+    {
+        switch (clockid)
+        {
+            case ::time::process_cputime:
+            case ::time::thread_cputime:
+                break;
+            default:
+                if (!::time::is_valid(clockid))
+                    return (errno = EINVAL, -1);
+                break;
+        }
+
+        if (res != nullptr)
+        {
+            const bool coarse = (clockid == ::time::realtime_coarse || clockid == ::time::monotonic_coarse);
+            const timespec ts { coarse ? ::time::coarse_period : 1 };
+            lib::copy_to_user(res, &ts, sizeof(timespec));
+        }
+        return 0;
+    }
+
+    int clock_nanosleep(clockid_t clockid, int flags, const timespec __user *req, timespec __user *rem)
+    {
+        switch (clockid)
+        {
+            case ::time::realtime:
+            case ::time::monotonic:
+            case ::time::boottime:
+                break;
+            case ::time::process_cputime:
+            case ::time::thread_cputime:
+                return (errno = ENOTSUP, -1);
+            default:
+                return (errno = EINVAL, -1);
+        }
+
+        timespec ts;
+        lib::copy_from_user(&ts, req, sizeof(timespec));
+        if (!is_valid(ts))
+            return (errno = EINVAL, -1);
+
+        if (flags & timer_abstime)
+        {
+            // interruptions just restart it with the same deadline
+            sleep_until(clockid, ts.to_ns());
+            return 0;
+        }
+
+        const auto ns = static_cast<std::uint64_t>(ts.to_ns());
+        if (ns == 0)
+        {
+            sched::yield();
+            return 0;
+        }
+
+        const auto left = sleep_ns(ns);
+        if (left == 0)
+            return 0;
+
+        if (rem != nullptr)
+        {
+            const timespec remaining { left };
+            lib::copy_to_user(rem, &remaining, sizeof(timespec));
+        }
+        return (errno = EINTR, -1);
+    }
+
+    int nanosleep(const timespec __user *req, timespec __user *rem)
+    {
+        return clock_nanosleep(::time::monotonic, 0, req, rem);
+    }
+
+    int timerfd_create(clockid_t clockid, int flags)
+    {
+        if (flags & ~(vfs::o_nonblock | vfs::o_closexec))
+            return (errno = EINVAL, -1);
+        if (!is_valid_timer_clock(clockid))
+            return (errno = EINVAL, -1);
+
+        const auto created = fs::tmpfs::create_anonymous("[timerfd]", timerfd_ops::singleton());
+        if (!created.has_value())
+            return (errno = ENOMEM, -1);
+
+        const auto proc = sched::this_thread()->parent;
+
+        auto fdesc = vfs::filedesc::create(created.value(), vfs::o_rdwr | flags);
+        fdesc->file->private_data = std::make_shared<timerfd>(clockid, fdesc->file->pollers);
+
+        const auto fd = proc->fdt.allocate_fd(fdesc, 0, false);
+        if (fd < 0)
+            return (errno = EMFILE, -1);
+        return fd;
+    }
+
+    int timerfd_settime(int fd, int flags, const itimerspec __user *new_value, itimerspec __user *old_value)
+    {
+        if (flags & ~(tfd_timer_abstime | tfd_timer_cancel_on_set))
+            return (errno = EINVAL, -1);
+
+        const auto tfd = get_timerfd(fd);
+        if (tfd == nullptr)
+            return -1;
+
+        const auto spec = copy_itimerspec(new_value);
+        if (!spec.has_value())
+            return (errno = EINVAL, -1);
+
+        if (old_value != nullptr)
+        {
+            const auto old = to_itimerspec(*tfd);
+            lib::copy_to_user(old_value, &old, sizeof(itimerspec));
+        }
+        set_from(*tfd, spec.value(), flags & tfd_timer_abstime);
+
+        // ignored unless it is an absolute wall clock timer
+        const bool cancel = (flags & tfd_timer_abstime) && (flags & tfd_timer_cancel_on_set) && tfd->clockid == ::time::realtime;
+        {
+            const std::unique_lock _ { tfd->lock };
+            tfd->cancel_on_set = cancel;
+            tfd->cancelled = false;
+        }
+        if (cancel)
+            tfd->listen();
+        return 0;
+    }
+
+    int timerfd_gettime(int fd, itimerspec __user *curr_value)
+    {
+        const auto tfd = get_timerfd(fd);
+        if (tfd == nullptr)
+            return -1;
+
+        const auto curr = to_itimerspec(*tfd);
+        lib::copy_to_user(curr_value, &curr, sizeof(itimerspec));
+        return 0;
+    }
+
+    int timer_create(clockid_t clockid, sigevent __user *sevp, int __user *timerid)
+    {
+        if (!is_valid_timer_clock(clockid))
+            return (errno = EINVAL, -1);
+
+        // a null sevp means SIGALRM
+        int notify = sigev_signal;
+        if (sevp != nullptr)
+        {
+            sigevent sev;
+            lib::copy_from_user(&sev, sevp, sizeof(sigevent));
+            notify = sev.sigev_notify;
+        }
+
+        // TODO: the rest need signals
+        if (notify != sigev_none)
+            return (errno = ENOTSUP, -1);
+
+        auto &timers = timers_of(sched::this_thread()->parent);
+        const std::unique_lock _ { timers.lock };
+
+        const auto id = timers.next_id++;
+        timers.posix[id] = std::make_unique<interval_timer>(clockid);
+        lib::copy_to_user(timerid, &id, sizeof(int));
+        return 0;
+    }
+
+    int timer_settime(int timerid, int flags, const itimerspec __user *new_value, itimerspec __user *old_value)
+    {
+        if (flags & ~timer_abstime)
+            return (errno = EINVAL, -1);
+
+        const auto spec = copy_itimerspec(new_value);
+        if (!spec.has_value())
+            return (errno = EINVAL, -1);
+
+        auto &timers = timers_of(sched::this_thread()->parent);
+        const std::unique_lock _ { timers.lock };
+
+        const auto it = timers.posix.find(timerid);
+        if (it == timers.posix.end())
+            return (errno = EINVAL, -1);
+
+        if (old_value != nullptr)
+        {
+            const auto old = to_itimerspec(*it->second);
+            lib::copy_to_user(old_value, &old, sizeof(itimerspec));
+        }
+        set_from(*it->second, spec.value(), flags & timer_abstime);
+        return 0;
+    }
+
+    int timer_gettime(int timerid, itimerspec __user *curr_value)
+    {
+        auto &timers = timers_of(sched::this_thread()->parent);
+        const std::unique_lock _ { timers.lock };
+
+        const auto it = timers.posix.find(timerid);
+        if (it == timers.posix.end())
+            return (errno = EINVAL, -1);
+
+        const auto curr = to_itimerspec(*it->second);
+        lib::copy_to_user(curr_value, &curr, sizeof(itimerspec));
+        return 0;
+    }
+
+    int timer_getoverrun(int timerid)
+    {
+        auto &timers = timers_of(sched::this_thread()->parent);
+        const std::unique_lock _ { timers.lock };
+
+        const auto it = timers.posix.find(timerid);
+        if (it == timers.posix.end())
+            return (errno = EINVAL, -1);
+
+        auto &timer = *it->second;
+        const std::unique_lock __ { timer.lock };
+        return static_cast<int>(std::min<std::uint64_t>(timer.overrun, std::numeric_limits<int>::max()));
+    }
+
+    int timer_delete(int timerid)
+    {
+        auto &timers = timers_of(sched::this_thread()->parent);
+        const std::unique_lock _ { timers.lock };
+
+        if (timers.posix.erase(timerid) != 1)
+            return (errno = EINVAL, -1);
+        return 0;
+    }
+
+    int getitimer(int which, itimerval __user *curr_value)
+    {
+        // TODO: ITIMER_VIRTUAL and ITIMER_PROF
+        if (which != itimer_real)
+            return (errno = EINVAL, -1);
+
+        const auto [value, interval] = timers_of(sched::this_thread()->parent).real.get();
+        const itimerval curr {
+            timespec { interval }.to_timeval(),
+            timespec { value }.to_timeval()
+        };
+        lib::copy_to_user(curr_value, &curr, sizeof(itimerval));
+        return 0;
+    }
+
+    int setitimer(int which, const itimerval __user *new_value, itimerval __user *old_value)
+    {
+        if (which != itimer_real)
+            return (errno = EINVAL, -1);
+
+        itimerval val;
+        lib::copy_from_user(&val, new_value, sizeof(itimerval));
+
+        const auto is_valid_tv = [](const timeval &tv) {
+            return tv.tv_sec >= 0 && tv.tv_usec >= 0 && tv.tv_usec < 1'000'000;
+        };
+        if (!is_valid_tv(val.it_value) || !is_valid_tv(val.it_interval))
+            return (errno = EINVAL, -1);
+
+        if (old_value != nullptr && getitimer(which, old_value) < 0)
+            return -1;
+
+        timers_of(sched::this_thread()->parent).real.set(
+            static_cast<std::uint64_t>(timespec { val.it_value }.to_ns()),
+            static_cast<std::uint64_t>(timespec { val.it_interval }.to_ns())
+        );
+        return 0;
+    }
+
+    unsigned int alarm(unsigned int seconds)
+    {
+        auto &real = timers_of(sched::this_thread()->parent).real;
+        const auto [left, interval] = real.get();
+        lib::unused(interval);
+
+        real.set(static_cast<std::uint64_t>(seconds) * 1'000'000'000, 0);
+
+        // rounded to the nearest second, but a pending alarm is never 0
+        if (left == 0)
+            return 0;
+        return std::max<unsigned int>(1, static_cast<unsigned int>((left + 500'000'000) / 1'000'000'000));
+    }
+
+    int gettimeofday(timeval __user *tv, void __user *tz)
+    {
+        if (tv != nullptr)
+        {
+            const auto now = ::time::now().to_timeval();
+            lib::copy_to_user(tv, &now, sizeof(timeval));
+        }
+
+        // no time zones, struct timezone is two ints
+        if (tz != nullptr)
+        {
+            const std::int32_t zero[2] { };
+            lib::copy_to_user(tz, zero, sizeof(zero));
+        }
+        return 0;
+    }
+
+    time_t time(time_t __user *tloc)
+    {
+        const auto secs = ::time::now().tv_sec;
+        if (tloc != nullptr)
+            lib::copy_to_user(tloc, &secs, sizeof(time_t));
+        return secs;
+    }
+} // namespace syscall::time
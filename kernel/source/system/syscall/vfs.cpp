@@ -2,6 +2,7 @@
 
 module system.syscall.vfs;
 
+import drivers.fs.tmpfs;
 import system.scheduler;
 import system.vfs;
 import magic_enum;
@@ -14,6 +15,47 @@ namespace syscall::vfs
 
     namespace
     {
+        struct dirent64
+        {
+            ino_t d_ino;
+            off_t d_off;
+            std::uint16_t d_reclen;
+            std::uint8_t d_type;
+            char d_name[];
+        };
+
+        // packs entries into buffer back to back, like linux does
+        struct dirent_writer : dir_context
+        {
+            std::span<std::byte> buffer;
+            std::size_t used = 0;
+            bool full = false;
+
+            dirent_writer(std::span<std::byte> buffer) : buffer { buffer } { }
+
+            bool emit(std::string_view name, ino_t ino, std::uint8_t type, std::uint64_t next) override
+            {
+                const auto reclen = lib::align_up(offsetof(dirent64, d_name) + name.size() + 1, alignof(dirent64));
+                if (reclen > buffer.size() - used)
+                {
+                    full = true;
+                    return false;
+                }
+
+                const auto entry = reinterpret_cast<dirent64 *>(buffer.data() + used);
+                entry->d_ino = ino;
+                entry->d_off = static_cast<off_t>(next);
+                entry->d_reclen = static_cast<std::uint16_t>(reclen);
+                entry->d_type = type;
+                std::memcpy(entry->d_name, name.data(), name.size());
+                // zero the padding too, it's copied out as is
+                std::memset(entry->d_name + name.size(), 0, reclen - offsetof(dirent64, d_name) - name.size());
+
+                used += reclen;
+                return true;
+            }
+        };
+
         std::shared_ptr<filedesc> get_fd(sched::process *proc, int fdnum)
         {
             if (fdnum < 0)
@@ -55,6 +97,8 @@ namespace syscall::vfs
                     return ENOTBLK;
                 case error::symloop_max:
                     return ELOOP;
+                case error::name_too_long:
+                    return ENAMETOOLONG;
                 case error::target_is_a_dir:
                     return EISDIR;
                 case error::target_is_busy:
@@ -254,7 +298,7 @@ namespace syscall::vfs
             if (!fdesc->file->trunc(0))
                 return (errno = EINVAL, -1);
 
-            stat.update_time(stat::time::modify | stat::time::status);
+            touch(target, stat::time::modify | stat::time::status);
         }
 
         return fd;
@@ -299,7 +343,7 @@ namespace syscall::vfs
         if (ret > 0)
             lib::copy_to_user(buf, buffer.data(), static_cast<std::size_t>(ret));
 
-        stat.update_time(stat::time::access);
+        touch(*file, stat::time::access);
         return ret;
     }
 
@@ -324,8 +368,7 @@ namespace syscall::vfs
 
         // TODO: sync
 
-        auto &stat = file->path.dentry->inode->stat;
-        stat.update_time(stat::time::modify | stat::time::status);
+        touch(*file, stat::time::modify | stat::time::status);
         return ret;
     }
 
@@ -353,7 +396,7 @@ namespace syscall::vfs
         if (ret > 0)
             lib::copy_to_user(buf, buffer.data(), static_cast<std::size_t>(ret));
 
-        stat.update_time(stat::time::access);
+        touch(*file, stat::time::access);
         return ret;
     }
 
@@ -376,8 +419,7 @@ namespace syscall::vfs
         if (ret < 0)
             return (errno = -ret, -1);
 
-        auto &stat = file->path.dentry->inode->stat;
-        stat.update_time(stat::time::modify | stat::time::status);
+        touch(*file, stat::time::modify | stat::time::status);
         return ret;
     }
 
@@ -418,8 +460,7 @@ namespace syscall::vfs
             total_read += static_cast<std::size_t>(ret);
         }
 
-        auto &stat = file->path.dentry->inode->stat;
-        stat.update_time(stat::time::access);
+        touch(*file, stat::time::access);
 
         return static_cast<std::ssize_t>(total_read);
     }
@@ -453,8 +494,7 @@ namespace syscall::vfs
             total_written += static_cast<std::size_t>(ret);
         }
 
-        auto &stat = file->path.dentry->inode->stat;
-        stat.update_time(stat::time::modify | stat::time::status);
+        touch(*file, stat::time::modify | stat::time::status);
 
         return static_cast<std::ssize_t>(total_written);
     }
@@ -491,8 +531,7 @@ namespace syscall::vfs
             offset += static_cast<off_t>(ret);
         }
 
-        auto &stat = file->path.dentry->inode->stat;
-        stat.update_time(stat::time::access);
+        touch(*file, stat::time::access);
 
         return static_cast<std::ssize_t>(total_read);
     }
@@ -527,8 +566,7 @@ namespace syscall::vfs
             offset += static_cast<off_t>(ret);
         }
 
-        auto &stat = file->path.dentry->inode->stat;
-        stat.update_time(stat::time::modify | stat::time::status);
+        touch(*file, stat::time::modify | stat::time::status);
 
         return static_cast<std::ssize_t>(total_written);
     }
@@ -582,6 +620,34 @@ namespace syscall::vfs
         return file->offset = new_offset;
     }
 
+    std::ssize_t getdents64(int fd, void __user *dirp, std::size_t count)
+    {
+        const auto proc = sched::this_thread()->parent;
+
+        auto fdesc = get_fd(proc, fd);
+        if (fdesc == nullptr)
+            return -1;
+
+        auto &file = fdesc->file;
+        if (file->path.dentry->inode->stat.type() != stat::type::s_ifdir)
+            return (errno = ENOTDIR, -1);
+
+        lib::membuffer buffer { count };
+        dirent_writer writer { buffer.span() };
+        if (file->readdir(writer) < 0)
+            return -1;
+
+        // not even the first entry fit
+        if (writer.used == 0 && writer.full)
+            return (errno = EINVAL, -1);
+
+        if (writer.used > 0)
+            lib::copy_to_user(dirp, buffer.data(), writer.used);
+
+        touch(*file, stat::time::access);
+        return static_cast<std::ssize_t>(writer.used);
+    }
+
     int fstatat(int dirfd, const char __user *pathname, ::stat __user *statbuf, int flags)
     {
         const auto proc = sched::this_thread()->parent;
@@ -644,6 +710,86 @@ namespace syscall::vfs
         return faccessat(at_fdcwd, pathname, mode, 0);
     }
 
+    int ftruncate(int fd, off_t length)
+    {
+        const auto proc = sched::this_thread()->parent;
+
+        auto fdesc = get_fd(proc, fd);
+        if (fdesc == nullptr)
+            return -1;
+
+        auto &file = fdesc->file;
+        if (length < 0)
+            return (errno = EINVAL, -1);
+
+        if (!is_write(file->flags))
+            return (errno = EBADF, -1);
+
+        auto &stat = file->path.dentry->inode->stat;
+        if (stat.type() != stat::type::s_ifreg)
+            return (errno = EINVAL, -1);
+
+        const auto size = static_cast<std::size_t>(length);
+        const auto current_size = static_cast<std::size_t>(stat.st_size);
+        if (const auto seals = file->get_seals(); seals > 0)
+        {
+            if ((seals & f_seal_shrink) && size < current_size)
+                return (errno = EPERM, -1);
+            if ((seals & f_seal_grow) && size > current_size)
+                return (errno = EPERM, -1);
+        }
+
+        if (!file->trunc(size))
+            return (errno = EINVAL, -1);
+
+        touch(*file, stat::time::modify | stat::time::status);
+        return 0;
+    }
+
+    int memfd_create(const char __user *name, unsigned int flags)
+    {
+        constexpr unsigned int mfd_cloexec = 0x01;
+        constexpr unsigned int mfd_allow_sealing = 0x02;
+        constexpr unsigned int mfd_hugetlb = 0x04;
+        constexpr unsigned int mfd_huge_mask = 0x3F << 26;
+
+        if (flags & ~(mfd_cloexec | mfd_allow_sealing | mfd_hugetlb | mfd_huge_mask))
+            return (errno = EINVAL, -1);
+
+        // only the default huge page size is supported
+        if ((flags & mfd_huge_mask) && !(flags & mfd_hugetlb))
+            return (errno = EINVAL, -1);
+
+        if (name == nullptr)
+            return (errno = EFAULT, -1);
+
+        // 249 = NAME_MAX - strlen("memfd:")
+        const auto name_len = lib::strnlen_user(name, 250);
+        if (name_len == 250)
+            return (errno = EINVAL, -1);
+
+        std::string fullname { "memfd:" };
+        fullname.resize(fullname.size() + name_len);
+        lib::copy_from_user(fullname.data() + 6, name, name_len);
+
+        const auto created = fs::tmpfs::create_anonymous(fullname, flags & mfd_allow_sealing, flags & mfd_hugetlb);
+        if (!created.has_value())
+            return (errno = map_error(created.error()), -1);
+
+        const auto proc = sched::this_thread()->parent;
+
+        auto &stat = created->dentry->inode->stat;
+        stat.st_uid = proc->euid;
+        stat.st_gid = proc->egid;
+
+        auto fdesc = filedesc::create(created.value(), o_rdwr | ((flags & mfd_cloexec) ? o_closexec : 0));
+        const auto fd = proc->fdt.allocate_fd(fdesc, 0, false);
+        if (fd < 0)
+            return (errno = EMFILE, -1);
+
+        return fd;
+    }
+
     int ioctl(int fd, unsigned long request, void __user *argp)
     {
         const auto proc = sched::this_thread()->parent;
@@ -693,6 +839,10 @@ namespace syscall::vfs
                 fdesc->file->flags = (fdesc->file->flags & ~changeable_status_flags) | new_flags;
                 break;
             }
+            case 1033: // F_ADD_SEALS
+                return fdesc->file->add_seals(static_cast<int>(arg));
+            case 1034: // F_GET_SEALS
+                return fdesc->file->get_seals();
             default:
                 return (errno = EINVAL, -1);
         }
@@ -755,11 +905,94 @@ namespace syscall::vfs
     {
         const auto proc = sched::this_thread()->parent;
 
-        const auto path_str = vfs::pathname_from(proc->cwd);
-        if (path_str.size() + 1 > size)
+        // leave room for the terminator
+        const auto buffer = scratch();
+        const auto path_str = pathname_from(proc->cwd, buffer.first(buffer.size() - 1));
+        if (!path_str.has_value())
+            return (errno = map_error(path_str.error()), nullptr);
+
+        const auto len = path_str->size();
+        if (len + 1 > size)
             return (errno = ERANGE, nullptr);
 
-        lib::copy_to_user(buf, path_str.c_str(), path_str.size() + 1);
+        buffer.back() = '\0';
+        lib::copy_to_user(buf, path_str->data(), len + 1);
         return (__force char *)(buf);
     }
+
+    int mount(const char __user *source, const char __user *target, const char __user *fstype, unsigned long flags, const void __user *data)
+    {
+        // filesystem options aren't supported
+        lib::unused(data);
+
+        // old userspace puts a magic number in the top half
+        constexpr unsigned long ms_mgc_msk = 0xFFFF0000;
+        constexpr unsigned long ms_mgc_val = 0xC0ED0000;
+        // these change existing mounts, which vfs can't do yet
+        constexpr unsigned long ms_remount = 0x20;
+        constexpr unsigned long ms_bind = 0x1000;
+        constexpr unsigned long ms_move = 0x2000;
+
+        // only asks for fewer messages, nothing to enforce
+        constexpr unsigned long ms_silent = 0x8000;
+
+        // ms_* in vfs use the linux values. only the atime ones are enforced,
+        // rdonly, nosuid, nodev and noexec would be silently ignored
+        constexpr unsigned long supported =
+            ms_noatime | ms_nodiratime | ms_relatime |
+            ms_strictatime | ms_lazytime;
+
+        const auto proc = sched::this_thread()->parent;
+        if (proc->euid != 0)
+            return (errno = EPERM, -1);
+
+        if ((flags & ms_mgc_msk) == ms_mgc_val)
+            flags &= ~ms_mgc_msk;
+
+        flags &= ~ms_silent;
+        if (flags & (ms_remount | ms_bind | ms_move))
+            return (errno = EINVAL, -1);
+        if (flags & ~supported)
+            return (errno = EINVAL, -1);
+
+        if (fstype == nullptr)
+            return (errno = EFAULT, -1);
+
+        const auto fstype_len = lib::strnlen_user(fstype, vfs::path_max);
+        if (fstype_len == 0 || fstype_len == vfs::path_max)
+            return (errno = EINVAL, -1);
+
+        std::string fstype_str(fstype_len, 0);
+        lib::copy_from_user(fstype_str.data(), fstype, fstype_len);
+
+        auto target_path = get_path(target);
+        if (!target_path.has_value())
+            return -1;
+
+        if (target_path->is_relative())
+        {
+            const auto buffer = scratch();
+            const auto cwd = pathname_from(proc->cwd, buffer);
+            if (!cwd.has_value())
+                return (errno = map_error(cwd.error()), -1);
+            target_path = target_path->absolute(cwd.value());
+        }
+
+        // pseudo filesystems get a name like "none" or "tmpfs" here,
+        // only a path to a block device means anything to vfs
+        lib::path source_path { };
+        if (source != nullptr)
+        {
+            auto val = get_path(source);
+            if (!val.has_value())
+                return -1;
+            if (val->is_absolute())
+                source_path = std::move(val.value());
+        }
+
+        const auto ret = ::vfs::mount(source_path, target_path.value(), fstype_str, static_cast<int>(flags));
+        if (!ret)
+            return (errno = map_error(ret.error()), -1);
+        return 0;
+    }
 } // namespace syscall::vfs
\ No newline at end of file
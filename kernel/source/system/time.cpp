@@ -2,6 +2,7 @@
 
 module system.time;
 
+import system.vdso;
 import frigg;
 import arch;
 import boot;
@@ -30,13 +31,78 @@ namespace time
             higher_priority
         > clocks;
         clock *main = nullptr;
+
+        // mult is 32.32 fixed point, unity runs at the clock source's rate
+        constexpr std::uint64_t unity = 1ull << 32;
+        // the most ntp will slew
+        constexpr std::int64_t max_ppb = 500'000;
+
+        constinit lib::seqlock lock;
+        constinit state tk {
+            .raw_last = 0,
+            .mono_last = 0,
+            .mult = unity,
+            .raw_offset = 0,
+            .realtime_offset = 0,
+            .boot_offset = 0,
+            .coarse_mono = 0
+        };
+        constinit std::int64_t ppb = 0;
+
+        std::atomic_uint64_t last_tick = 0;
+
+        std::uint64_t raw_now()
+        {
+            return main ? main->ns() : 0;
+        }
+
+        std::uint64_t mono_at(std::uint64_t raw)
+        {
+            const auto delta = raw > tk.raw_last ? raw - tk.raw_last : 0;
+            return tk.mono_last + static_cast<std::uint64_t>((static_cast<uint128_t>(delta) * tk.mult) >> 32);
+        }
+
+        // the following need the lock held for writing
+
+        // moves the base to now, so a new mult only affects time from here on
+        void rebase(std::uint64_t raw)
+        {
+            tk.mono_last = mono_at(raw);
+            tk.raw_last = raw;
+            tk.coarse_mono = tk.mono_last;
+        }
+
+        void publish()
+        {
+            vdso::update_time(tk);
+        }
     } // namespace
 
     void register_clock(clock &clock)
     {
         log::info("time: registering clock source '{}'", clock.name);
-        clocks.push(&clock);
-        log::debug("time: main clock is set to '{}'", (main = clocks.top())->name);
+
+        lock.write_lock();
+        {
+            const bool first = (main == nullptr);
+            const auto old_raw = raw_now();
+            rebase(old_raw);
+
+            clocks.push(&clock);
+            main = clocks.top();
+
+            // new clocks are aligned to the old main one, so only the base moves
+            tk.raw_last = raw_now();
+            tk.raw_offset += static_cast<std::int64_t>(old_raw - tk.raw_last);
+
+            if (first)
+                tk.realtime_offset = boot::time() * 1'000'000'000 - static_cast<std::int64_t>(tk.mono_last);
+            publish();
+        }
+        lock.write_unlock();
+
+        vdso::update();
+        log::debug("time: main clock is set to '{}'", main->name);
     }
 
     clock *main_clock()
@@ -56,19 +122,107 @@ namespace time
         return true;
     }
 
-    // TODO: this is terrible and only temporary
+    bool is_valid(clockid_t clockid)
+    {
+        switch (clockid)
+        {
+            case realtime:
+            case monotonic:
+            case monotonic_raw:
+            case realtime_coarse:
+            case monotonic_coarse:
+            case boottime:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    std::uint64_t ns(clockid_t clockid)
+    {
+        return lock.read([clockid] -> std::uint64_t {
+            switch (clockid)
+            {
+                case monotonic_raw:
+                    return raw_now() + tk.raw_offset;
+                case realtime_coarse:
+                    return tk.coarse_mono + tk.realtime_offset;
+                case monotonic_coarse:
+                    return tk.coarse_mono;
+                default:
+                    break;
+            }
+
+            const auto mono = mono_at(raw_now());
+            switch (clockid)
+            {
+                case realtime:
+                    return mono + tk.realtime_offset;
+                case boottime:
+                    return mono + tk.boot_offset;
+                default:
+                    return mono;
+            }
+        });
+    }
+
     timespec now(clockid_t clockid)
     {
-        lib::unused(clockid);
+        return timespec { ns(clockid) };
+    }
+
+    state current_state()
+    {
+        return lock.read([] { return tk; });
+    }
+
+    void set_realtime(timespec ts)
+    {
+        lock.write_lock();
+        {
+            rebase(raw_now());
+            tk.realtime_offset = ts.to_ns() - static_cast<std::int64_t>(tk.mono_last);
+            publish();
+        }
+        lock.write_unlock();
+    }
 
+    void adjust_frequency(std::int64_t new_ppb)
+    {
+        new_ppb = std::clamp(new_ppb, -max_ppb, max_ppb);
+
+        lock.write_lock();
+        {
+            rebase(raw_now());
+            ppb = new_ppb;
+            tk.mult = unity + (static_cast<int128_t>(ppb) * unity) / 1'000'000'000;
+            publish();
+        }
+        lock.write_unlock();
+    }
+
+    std::int64_t frequency_adjustment()
+    {
+        return ppb;
+    }
+
+    void tick()
+    {
         if (main == nullptr)
-            return timespec { };
+            return;
 
-        const auto boot_time_s = boot::time();
-        const auto clock_ns = main->ns();
-        return timespec {
-            static_cast<time_t>(boot_time_s + clock_ns / 1'000'000'000),
-            static_cast<long>(clock_ns % 1'000'000'000)
-        };
+        // one cpu is enough
+        const auto raw = raw_now();
+        auto last = last_tick.load(std::memory_order_relaxed);
+        if (raw < last + coarse_period || !last_tick.compare_exchange_strong(last, raw, std::memory_order_relaxed))
+            return;
+
+        lock.write_lock();
+        {
+            // also keeps delta * mult small
+            rebase(raw);
+            publish();
+        }
+        lock.write_unlock();
     }
-} // namespace time
\ No newline at end of file
+} // namespace time
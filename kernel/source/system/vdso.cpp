@@ -0,0 +1,158 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module;
+
+#include <vdso/data.h>
+
+module system.vdso;
+
+import system.memory;
+import system.time;
+import system.cpu;
+import lib;
+import cppstd;
+
+namespace vdso
+{
+    namespace arch
+    {
+        // the linked vdso, empty if there is none
+        std::span<const std::byte> image();
+        // picks the clock mode and fills in its parameters
+        void update(vdso_data &data);
+        // physical address of a cpu's pvclock page, 0 if it has none
+        std::uintptr_t pvclock_page(std::size_t cpuidx);
+    } // namespace arch
+
+    namespace
+    {
+        // keeps it away from null and from mmap allocations
+        constexpr std::uintptr_t min_address = 0x7000'0000'0000;
+
+        // backed by pages adopted at boot, which are never freed
+        class object : public vmm::object
+        {
+            private:
+            std::uintptr_t request_page(std::size_t idx) override
+            {
+                lib::unused(idx);
+                return 0;
+            }
+
+            void write_back() override { }
+        };
+
+        std::shared_ptr<object> vvar;
+        std::shared_ptr<object> text;
+        std::size_t text_pages = 0;
+
+        vdso_data *data = nullptr;
+        // taken with the time write lock held, so no interrupts
+        lib::spinlock_irq update_lock;
+
+        void write_begin()
+        {
+            std::atomic_ref seq { data->seq };
+            seq.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        void write_end()
+        {
+            std::atomic_ref seq { data->seq };
+            seq.fetch_add(1, std::memory_order_release);
+        }
+
+        void copy_state(const time::state &tk)
+        {
+            data->raw_last = tk.raw_last;
+            data->mono_last = tk.mono_last;
+            data->mult = tk.mult;
+            data->raw_offset = tk.raw_offset;
+            data->realtime_offset = tk.realtime_offset;
+            data->boot_offset = tk.boot_offset;
+            data->coarse_mono = tk.coarse_mono;
+        }
+    } // namespace
+
+    std::uintptr_t map(vmm::vmspace &vmspace)
+    {
+        if (!text)
+            return 0;
+
+        const auto vvar_len = VDSO_VVAR_PAGES * VDSO_PAGE_SIZE;
+        const auto text_len = text_pages * VDSO_PAGE_SIZE;
+
+        const auto base = vmspace.find_free_region(vvar_len + text_len, min_address);
+        if (!vmspace.map(base, vvar_len, vmm::prot::read, vmm::flag::shared, vvar, 0))
+            return 0;
+
+        if (!vmspace.map(base + vvar_len, text_len, vmm::prot::read | vmm::prot::exec, vmm::flag::shared, text, 0))
+        {
+            lib::unused(vmspace.unmap(base, vvar_len));
+            return 0;
+        }
+        return base + vvar_len;
+    }
+
+    void update()
+    {
+        if (data == nullptr)
+            return;
+
+        const auto tk = time::current_state();
+
+        const std::unique_lock _ { update_lock };
+        write_begin();
+        copy_state(tk);
+        arch::update(*data);
+        write_end();
+    }
+
+    void update_time(const time::state &tk)
+    {
+        if (data == nullptr)
+            return;
+
+        const std::unique_lock _ { update_lock };
+        write_begin();
+        copy_state(tk);
+        write_end();
+    }
+
+    lib::initgraph::task vdso_task
+    {
+        "vdso.initialise",
+        lib::initgraph::postsched_init_engine,
+        [] {
+            const auto image = arch::image();
+            if (image.empty())
+                return;
+
+            lib::bug_on(vmm::default_page_size() != VDSO_PAGE_SIZE);
+            lib::bug_on(cpu::count() > VDSO_MAX_CPUS);
+
+            text_pages = lib::div_roundup(image.size(), VDSO_PAGE_SIZE);
+            const auto text_phys = pmm::alloc<std::uintptr_t>(text_pages, true);
+            std::memcpy(lib::tohh(reinterpret_cast<void *>(text_phys)), image.data(), image.size());
+
+            text = std::make_shared<object>();
+            lib::bug_on(!text->adopt_pages(0, text_phys, text_pages));
+
+            const auto data_phys = pmm::alloc<std::uintptr_t>(1, true);
+            data = lib::tohh(reinterpret_cast<vdso_data *>(data_phys));
+
+            vvar = std::make_shared<object>();
+            lib::bug_on(!vvar->adopt_pages(0, data_phys, 1));
+
+            for (std::size_t i = 0; i < cpu::count(); i++)
+            {
+                if (const auto page = arch::pvclock_page(i))
+                    lib::bug_on(!vvar->adopt_pages(1 + i, page, 1));
+            }
+
+            update();
+            log::info("vdso: {} pages, clock mode {}", text_pages, data->mode);
+        }
+    };
+} // namespace vdso
@@ -5,6 +5,8 @@ module system.vfs;
 import system.scheduler;
 import system.cpu.self;
 import system.dev;
+import system.time;
+import system.rcu;
 import drivers.fs;
 import lib;
 import cppstd;
@@ -29,6 +31,251 @@ namespace vfs
             >, lib::mutex
         > filesystems;
 
+        void retire(dentry &parent, const std::shared_ptr<dentry> &child)
+        {
+            parent.child_index.remove(child.get());
+            parent.cursors.remove(child.get());
+
+            child->retired.self = child;
+            rcu::call(&child->retired, [](rcu::head *head) {
+                static_cast<dentry::retired_ref *>(head)->self.reset();
+            });
+        }
+
+        // callers hold the write lock of parent's children
+        void add_child(dentry &parent, auto &children, std::shared_ptr<dentry> child)
+        {
+            // the key points into the old dentry's name, don't keep it
+            if (auto it = children.find(child->name); it != children.end())
+            {
+                retire(parent, it->second);
+                children.erase(it);
+            }
+
+            parent.child_index.insert(child.get());
+            child->cookie = parent.next_cookie++;
+            parent.cursors.insert(child.get());
+            const std::string_view name = child->name;
+            children.emplace(name, std::move(child));
+        }
+
+        // a path whose dentry is borrowed rather than referenced. only valid
+        // inside an rcu read side section, retired dentries outlive those
+        struct borrowed_path
+        {
+            std::shared_ptr<mount> mnt;
+            dentry *dentry;
+        };
+
+        // takes a reference that outlives the read side section
+        std::optional<path> pin(const std::shared_ptr<mount> &mnt, dentry *dentry)
+        {
+            auto ref = dentry->weak_from_this().lock();
+            if (!ref)
+                return std::nullopt;
+            return path { mnt, std::move(ref) };
+        }
+
+        // steps out of the mounts cur is the root of
+        void leave_mounts(borrowed_path &cur)
+        {
+            while (cur.dentry == cur.mnt->root.get())
+            {
+                const auto &on = cur.mnt->mounted_on.value();
+                cur = borrowed_path { on.mnt, on.dentry.get() };
+            }
+        }
+
+        borrowed_path parent_of(borrowed_path cur)
+        {
+            leave_mounts(cur);
+            cur.dentry = cur.dentry->parent.lock().get();
+            leave_mounts(cur);
+            return cur;
+        }
+
+        // the root of whatever is mounted on child, if anything. crossed is
+        // only set if a mount was entered
+        dentry *enter_mounts(const std::shared_ptr<mount> &mnt, dentry *child, std::shared_ptr<mount> &crossed)
+        {
+            again:
+            for (const auto &child_mnt : child->child_mounts)
+            {
+                auto locked = child_mnt.lock();
+                if (locked && locked->mounted_on->mnt == (crossed ? crossed : mnt))
+                {
+                    child = locked->root.get();
+                    crossed = std::move(locked);
+                    goto again;
+                }
+            }
+            return child;
+        }
+
+        // the next component of rest, which is left pointing after it
+        std::string_view next_component(std::string_view &rest)
+        {
+            const auto start = rest.find_first_not_of('/');
+            if (start == std::string_view::npos)
+            {
+                rest = { };
+                return { };
+            }
+            rest.remove_prefix(start);
+
+            const auto ret = rest.substr(0, rest.find('/'));
+            rest.remove_prefix(ret.size());
+            return ret;
+        }
+
+        // nothing but slashes and dots left
+        bool at_end(std::string_view rest)
+        {
+            while (true)
+            {
+                const auto component = next_component(rest);
+                if (component.empty())
+                    return true;
+                if (component != ".")
+                    return false;
+            }
+        }
+
+        // follow_last also expands a symlink in the last component
+        auto walk(std::optional<path> parent, std::string_view pathname, bool follow_last, std::size_t links_left) -> expect<resolve_res>
+        {
+            if (!parent || pathname.starts_with('/'))
+                parent = get_root(false);
+
+            lib::bug_on(!parent.has_value());
+
+            if (at_end(pathname))
+                return resolve_res { parent.value(), parent.value() };
+
+            lib::bug_on(parent->mnt == nullptr);
+
+            // symlink targets are spliced in front of what is left of the
+            // path, right aligned in the scratch buffer
+            const auto buffer = scratch();
+            const auto buffer_end = buffer.data() + buffer.size();
+
+            std::optional<path> root_path { };
+            // the directory we dropped the read side section in to populate
+            std::optional<path> pinned { };
+
+            std::string_view rest = pathname;
+            borrowed_path current { parent->mnt, parent->dentry.get() };
+
+            rcu::read_lock();
+            const auto ret = [&]() -> expect<resolve_res>
+            {
+                while (true)
+                {
+                    const auto name = next_component(rest);
+                    const bool last = at_end(rest);
+
+                    if (name == ".")
+                        continue;
+
+                    if (name == "..")
+                    {
+                        current = parent_of(current);
+                        if (last)
+                        {
+                            const auto up = parent_of(current);
+                            const auto res_parent = pin(up.mnt, up.dentry);
+                            const auto res_target = pin(current.mnt, current.dentry);
+                            if (!res_parent || !res_target)
+                                return std::unexpected(error::not_found);
+                            return resolve_res { res_parent.value(), res_target.value() };
+                        }
+                        continue;
+                    }
+
+                    auto child = current.dentry->child_index.find(name);
+                    if (child == nullptr)
+                    {
+                        // not cached, the filesystem may have to sleep for it
+                        pinned = pin(current.mnt, current.dentry);
+                        if (!pinned)
+                            return std::unexpected(error::not_found);
+
+                        rcu::read_unlock();
+                        const bool populated = populate(pinned.value(), name);
+                        rcu::read_lock();
+
+                        if (populated)
+                            child = current.dentry->child_index.find(name);
+                        if (child == nullptr)
+                            return std::unexpected(error::not_found);
+                    }
+
+                    std::shared_ptr<mount> crossed { };
+                    const auto next = enter_mounts(current.mnt, child, crossed);
+                    const auto &next_mnt = crossed ? crossed : current.mnt;
+
+                    const auto &stat = next->inode->stat;
+                    const bool is_symlink = stat.type() == stat::type::s_iflnk && !next->symlinked_to.empty();
+                    if (is_symlink && (!last || follow_last))
+                    {
+                        if (links_left-- == 0)
+                            return std::unexpected(error::symloop_max);
+
+                        // whatever trails the last component doesn't matter
+                        if (last)
+                            rest = { };
+
+                        const std::string_view target = next->symlinked_to;
+                        const auto size = target.size() + rest.size();
+                        if (size > buffer.size())
+                            return std::unexpected(error::name_too_long);
+
+                        // rest may already be the tail of the buffer
+                        const auto dest = buffer_end - size;
+                        std::memmove(dest + target.size(), rest.data(), rest.size());
+                        std::memcpy(dest, target.data(), target.size());
+                        rest = std::string_view { dest, size };
+
+                        // relative targets start from the directory the link is in
+                        if (target.starts_with('/'))
+                        {
+                            if (!root_path)
+                                root_path = get_root(false);
+                            current = borrowed_path { root_path->mnt, root_path->dentry.get() };
+                        }
+
+                        if (at_end(rest))
+                        {
+                            const auto res = pin(current.mnt, current.dentry);
+                            if (!res)
+                                return std::unexpected(error::not_found);
+                            return resolve_res { res.value(), res.value() };
+                        }
+                        continue;
+                    }
+
+                    if (last)
+                    {
+                        const auto res_parent = pin(current.mnt, current.dentry);
+                        const auto res_target = pin(next_mnt, next);
+                        if (!res_parent || !res_target)
+                            return std::unexpected(error::not_found);
+                        return resolve_res { res_parent.value(), res_target.value() };
+                    }
+
+                    if (stat.type() != stat::type::s_ifdir)
+                        return std::unexpected(error::not_a_dir);
+
+                    if (crossed)
+                        current.mnt = std::move(crossed);
+                    current.dentry = next;
+                }
+            } ();
+            rcu::read_unlock();
+
+            return ret;
+        }
+
         std::atomic<dev_t> next_dev = 1;
         dev_t allocate_dev()
         {
@@ -76,35 +323,54 @@ namespace vfs
         return vfs::root;
     }
 
-    std::string pathname_from(path path)
+    std::span<char> scratch()
+    {
+        // nothing can run concurrently before the scheduler
+        static char early[path_max];
+        if (!sched::is_initialised())
+            return early;
+
+        auto &buffer = sched::this_thread()->path_scratch;
+        if (!buffer)
+            buffer = std::make_unique<char[]>(path_max);
+        return { buffer.get(), path_max };
+    }
+
+    auto pathname_from(const path &path, std::span<char> buffer) -> expect<std::string_view>
     {
-        std::size_t len = 0;
-        std::vector<std::string_view> segments;
+        // built backwards from the end, so no lengths need to be known up front
+        const auto end = buffer.data() + buffer.size();
+        auto pos = end;
+
+        rcu::guard _;
+        borrowed_path current { path.mnt, path.dentry.get() };
         while (true)
         {
-            while (path.dentry == path.mnt->root)
-                path = path.mnt->mounted_on.value();
-
-            if (path.dentry == vfs::root)
+            leave_mounts(current);
+            if (current.dentry == vfs::root.get())
                 break;
 
-            segments.push_back(path.dentry->name);
-            len += path.dentry->name.size();
-            path.dentry = path.dentry->parent.lock();
+            const std::string_view name = current.dentry->name;
+            if (name.size() + 1 > static_cast<std::size_t>(pos - buffer.data()))
+                return std::unexpected(error::name_too_long);
+
+            pos -= name.size();
+            std::memcpy(pos, name.data(), name.size());
+            *--pos = '/';
+
+            current.dentry = current.dentry->parent.lock().get();
         }
-        std::string result;
-        result.reserve(std::max(1zu, len + segments.size()));
-        for (auto it = segments.rbegin(); it != segments.rend(); it++)
+
+        if (pos == end)
         {
-            result += '/';
-            result += *it;
+            if (buffer.empty())
+                return std::unexpected(error::name_too_long);
+            *--pos = '/';
         }
-        if (result.empty())
-            result = "/";
-        return result;
+        return std::string_view { pos, end };
     }
 
-    auto path_for(lib::path _path) -> expect<path>
+    auto path_for(lib::path_view _path) -> expect<path>
     {
         std::optional<path> parent { };
         if (sched::is_initialised())
@@ -115,138 +381,30 @@ namespace vfs
         return res->target;
     }
 
-    auto resolve(std::optional<path> parent, lib::path _path) -> expect<resolve_res>
+    auto resolve(std::optional<path> parent, lib::path_view path) -> expect<resolve_res>
     {
-        if (!parent || _path.is_absolute())
-            parent = get_root(false);
-
-        lib::bug_on(!parent.has_value());
-
-        if (_path == "/" || _path.empty() || _path == ".")
-            return resolve_res { parent.value(), parent.value() };
-
-        lib::bug_on(parent->mnt == nullptr);
-
-        auto current = parent.value();
-
-        auto split = std::views::split(_path.str(), '/');
-        const std::size_t size = std::ranges::distance(split);
-        for (std::size_t i = 0; const auto segment_view : split)
-        {
-            i++;
-            const std::string_view segment { segment_view };
-            if (segment.empty())
-                continue;
-
-            const bool last = i == size;
-
-            if (segment == "..")
-            {
-                auto resolve_mounts = [](auto path)
-                {
-                    while (path.dentry == path.mnt->root)
-                        path = path.mnt->mounted_on.value();
-                    return path;
-                };
-
-                current = resolve_mounts(current);
-                current.dentry = current.dentry->parent.lock();
-                current = resolve_mounts(current);
-
-                if (last)
-                {
-                    auto parent = resolve_mounts(current);
-                    parent.dentry = parent.dentry->parent.lock();
-                    parent = resolve_mounts(parent);
-                    return resolve_res { parent, current };
-                }
-                continue;
-            }
-
-            try_again:
-            {
-                const auto &rlocked = current.dentry->children.read_lock();
-                if (auto it = rlocked->find(segment); it != rlocked->end())
-                {
-                    auto dentry = it->second;
-                    auto mnt = current.mnt;
-
-                    again:
-                    for (const auto &child_mnt : dentry->child_mounts)
-                    {
-                        const auto locked = child_mnt.lock();
-                        if (mnt == locked->mounted_on->mnt)
-                        {
-                            mnt = locked;
-                            dentry = locked->root;
-                            goto again;
-                        }
-                    }
-
-                    path next { mnt, dentry };
-
-                    if (last)
-                        return resolve_res { current, next };
-
-                    if (next.dentry->inode->stat.type() == stat::type::s_iflnk)
-                    {
-                        const auto reduced = reduce(current, next);
-                        if (!reduced)
-                            return std::unexpected(reduced.error());
-                        next = reduced.value();
-                    }
-
-                    if (next.dentry->inode->stat.type() != stat::type::s_ifdir)
-                        return std::unexpected(error::not_a_dir);
-
-                    current = next;
-                    continue;
-                }
-            }
-
-            if (populate(current, segment))
-                goto try_again;
-
-            break;
-        }
-        return std::unexpected(error::not_found);
+        return walk(std::move(parent), std::string_view { path.data(), path.size() }, false, symloop_max);
     }
 
     auto reduce(path parent, path src, std::size_t symlink_depth) -> expect<path>
     {
-        const auto is_symlink = [&src]
-        {
-            const auto &dentry = src.dentry;
-            return
-                dentry->inode->stat.type() == stat::type::s_iflnk &&
-                !dentry->symlinked_to.empty();
-        };
-
-        const auto og = symlink_depth;
-        while (symlink_depth > 0)
-        {
-            if (!is_symlink())
-                return src;
-
-            const auto ret = resolve(parent, src.dentry->symlinked_to);
-            if (!ret || ret->target.dentry == src.dentry)
-                return std::unexpected(error::invalid_symlink);
-
-            parent = ret->parent;
-            src = ret->target;
-            symlink_depth--;
-        }
-
-        if (og && symlink_depth == 0 && is_symlink())
-            return std::unexpected(error::symloop_max);
+        const auto &dentry = src.dentry;
+        if (symlink_depth == 0 || dentry->inode->stat.type() != stat::type::s_iflnk || dentry->symlinked_to.empty())
+            return src;
 
-        return src;
+        // src keeps symlinked_to alive for the walk
+        const auto ret = walk(std::move(parent), dentry->symlinked_to, true, symlink_depth - 1);
+        if (!ret)
+            return std::unexpected(ret.error());
+        return ret->target;
     }
 
     auto mount(lib::path source_path, lib::path target_path, std::string_view fstype, int flags) -> expect<void>
     {
-        // TODO
-        lib::unused(flags);
+        // only the atime flags are honoured, the mount syscall refuses the rest
+        if (!(flags & (ms_noatime | ms_strictatime)))
+            flags |= ms_relatime;
+        flags &= ~ms_strictatime;
 
         auto fs = find_fs(fstype);
         if (!fs)
@@ -277,6 +435,7 @@ namespace vfs
             return std::unexpected(mnt.error());
 
         mnt.value()->mounted_on = target;
+        mnt.value()->flags = flags;
         target.dentry->child_mounts.push_back(mnt.value());
 
         log::info("vfs: mount('{}', '{}', '{}')", source_path, target_path, fstype);
@@ -322,7 +481,7 @@ namespace vfs
             dentry->name = name;
             dentry->inode = ret.value();
 
-            real_parent.dentry->children.write_lock().value()[dentry->name] = dentry;
+            add_child(*real_parent.dentry, real_parent.dentry->children.write_lock().value(), dentry);
             return path { real_parent.mnt, dentry };
         }
         return std::unexpected(ret.error());
@@ -350,7 +509,7 @@ namespace vfs
             dentry->symlinked_to = target.str();
             dentry->inode = ret.value();
 
-            real_parent.dentry->children.write_lock().value()[dentry->name] = dentry;
+            add_child(*real_parent.dentry, real_parent.dentry->children.write_lock().value(), dentry);
             return path { real_parent.mnt, dentry };
         }
         return std::unexpected(ret.error());
@@ -397,7 +556,7 @@ namespace vfs
             dentry->name = name;
             dentry->inode = ret.value();
 
-            real_parent.dentry->children.write_lock().value()[dentry->name] = dentry;
+            add_child(*real_parent.dentry, real_parent.dentry->children.write_lock().value(), dentry);
             return path { real_parent.mnt, dentry };
         }
         return std::unexpected(ret.error());
@@ -430,6 +589,7 @@ namespace vfs
             auto wlocked = real_parent->children.write_lock();
             auto it = wlocked->find(name);
             lib::bug_on(it == wlocked->end());
+            retire(*real_parent, it->second);
             wlocked->erase(it);
             return { };
         }
@@ -479,6 +639,46 @@ namespace vfs
         return true;
     }
 
+    namespace
+    {
+        // how stale relatime lets atime get
+        constexpr time_t relatime_max = 24 * 60 * 60;
+
+        bool wants_atime(const mount *mnt, const ::stat &stat, int flags)
+        {
+            if (flags & o_noatime)
+                return false;
+
+            const auto mflags = mnt ? mnt->flags : 0;
+            if (mflags & ms_noatime)
+                return false;
+            if ((mflags & ms_nodiratime) && stat.type() == ::stat::s_ifdir)
+                return false;
+            if (!(mflags & ms_relatime))
+                return true;
+
+            if (stat.st_atim <= stat.st_mtim || stat.st_atim <= stat.st_ctim)
+                return true;
+            return ::time::now(::time::realtime_coarse).tv_sec - stat.st_atim.tv_sec >= relatime_max;
+        }
+    } // namespace
+
+    void touch(const path &path, std::uint8_t which, int flags)
+    {
+        auto &stat = path.dentry->inode->stat;
+        if ((which & ::stat::time::access) && !wants_atime(path.mnt.get(), stat, flags))
+            which &= ~::stat::time::access;
+
+        // all filesystems are in memory, so lazytime has nothing to defer
+        if (which != 0)
+            stat.update_time(which);
+    }
+
+    void touch(const file &file, std::uint8_t which)
+    {
+        touch(file.path, which, file.flags);
+    }
+
     auto stat(std::optional<path> parent, lib::path path) -> expect<::stat>
     {
         auto res = resolve(parent, path);
@@ -505,13 +705,51 @@ namespace vfs
                 dentry->name = name;
                 dentry->inode = inode;
 
-                wlocked.value()[dentry->name] = dentry;
+                add_child(*parent.dentry, wlocked.value(), dentry);
             }
             return true;
         }
         return false;
     }
 
+    int dcache_readdir(const path &dir, dir_context &ctx)
+    {
+        auto &self = *dir.dentry;
+        if (ctx.pos == 0)
+        {
+            if (!ctx.emit(".", self.inode->stat.st_ino, dirent_type(stat::s_ifdir), 1))
+                return 0;
+            ctx.pos = 1;
+        }
+        if (ctx.pos == 1)
+        {
+            auto parent = self.parent.lock();
+            if (dir.mnt && dir.dentry == dir.mnt->root && dir.mnt->mounted_on)
+                parent = dir.mnt->mounted_on->dentry->parent.lock();
+            const auto ino = (parent ?: dir.dentry)->inode->stat.st_ino;
+
+            if (!ctx.emit("..", ino, dirent_type(stat::s_ifdir), 2))
+                return 0;
+            ctx.pos = 2;
+        }
+
+        // removed entries are gone from the tree and new ones go at the
+        // end, so the next cookie at or after pos is always where to resume
+        const auto rlocked = self.children.read_lock();
+        const auto start = self.cursors.lower_bound([pos = ctx.pos](const dentry &child) {
+            return child.cookie < pos;
+        });
+        for (auto it = start; it != self.cursors.end(); it++)
+        {
+            const auto &stat = it->inode->stat;
+            const auto next = it->cookie + 1;
+            if (!ctx.emit(it->name, stat.st_ino, dirent_type(stat.st_mode), next))
+                break;
+            ctx.pos = next;
+        }
+        return 0;
+    }
+
     bool fdtable::close(int fd)
     {
         return fds.write_lock()->erase(fd);
@@ -0,0 +1,109 @@
+// Copyright (C) 2024-2025  ilobilo
+
+module system.workqueue;
+
+import system.scheduler;
+import system.cpu.self;
+import system.cpu;
+import arch;
+import lib;
+import cppstd;
+
+namespace workqueue
+{
+    namespace
+    {
+        struct percpu
+        {
+            lib::spinlock lock;
+            work *head = nullptr;
+            work *tail = nullptr;
+
+            sched::thread *worker = nullptr;
+        };
+        cpu_local<percpu> local;
+        cpu_local_init(local);
+
+        [[noreturn]] void worker()
+        {
+            auto &pcpu = local.get();
+            const auto me = sched::this_thread();
+
+            while (true)
+            {
+                const bool ints = arch::int_switch_status(false);
+                pcpu.lock.lock();
+
+                const auto w = pcpu.head;
+                if (w == nullptr)
+                {
+                    // queue() wakes us only once we are off the cpu
+                    me->prepare_sleep();
+                    pcpu.lock.unlock();
+                    sched::yield();
+                    arch::int_switch(ints);
+                    continue;
+                }
+
+                pcpu.head = w->next;
+                if (pcpu.head == nullptr)
+                    pcpu.tail = nullptr;
+
+                pcpu.lock.unlock();
+                arch::int_switch(ints);
+
+                // may queue itself again
+                w->pending.store(false, std::memory_order_release);
+                w->func(w);
+            }
+        }
+    } // namespace
+
+    bool queue_on(std::size_t cpu, work &w)
+    {
+        lib::bug_on(cpu >= cpu::count());
+
+        if (w.pending.exchange(true, std::memory_order_acq_rel))
+            return false;
+
+        auto &pcpu = local.get(cpu::local::nth_base(cpu));
+
+        const bool ints = arch::int_switch_status(false);
+        pcpu.lock.lock();
+
+        w.next = nullptr;
+        if (pcpu.tail != nullptr)
+            pcpu.tail->next = &w;
+        else
+            pcpu.head = &w;
+        pcpu.tail = &w;
+
+        const auto worker = pcpu.worker;
+
+        pcpu.lock.unlock();
+        arch::int_switch(ints);
+
+        if (worker != nullptr)
+            worker->wake_up(0);
+        return true;
+    }
+
+    bool queue(work &w)
+    {
+        return queue_on(cpu::self()->idx, w);
+    }
+
+    lib::initgraph::task workers_task
+    {
+        "workqueue.workers.spawn",
+        lib::initgraph::postsched_init_engine,
+        [] {
+            for (std::size_t idx = 0; idx < cpu::count(); idx++)
+            {
+                const auto thread = sched::spawn_on(idx, 0, reinterpret_cast<std::uintptr_t>(worker));
+                thread->affinity = sched::cpumask { }.set(idx);
+                local.get(cpu::local::nth_base(idx)).worker = thread;
+            }
+        }
+    };
+} // namespace workqueue
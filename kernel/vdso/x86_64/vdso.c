@@ -0,0 +1,259 @@
+// Copyright (C) 2024-2025  ilobilo
+
+#include <vdso/data.h>
+#include <stdint.h>
+
+#define export __attribute__((visibility("default")))
+#define alias(name) __attribute__((weak, alias(#name)))
+
+struct timespec
+{
+    long tv_sec;
+    long tv_nsec;
+};
+
+struct timeval
+{
+    long tv_sec;
+    long tv_usec;
+};
+
+struct timezone
+{
+    int tz_minuteswest;
+    int tz_dsttime;
+};
+
+enum
+{
+    CLOCK_REALTIME = 0,
+    CLOCK_MONOTONIC = 1,
+    CLOCK_MONOTONIC_RAW = 4,
+    CLOCK_REALTIME_COARSE = 5,
+    CLOCK_MONOTONIC_COARSE = 6,
+    CLOCK_BOOTTIME = 7
+};
+
+enum
+{
+    SYS_gettimeofday = 96,
+    SYS_time = 201,
+    SYS_clock_gettime = 228,
+    SYS_getcpu = 309
+};
+
+// defined in vdso.ld, right before the image
+extern const volatile struct vdso_data vvar_data __attribute__((visibility("hidden")));
+extern const volatile uint8_t vvar_pvclock[] __attribute__((visibility("hidden")));
+
+static long syscall2(long num, long arg0, long arg1)
+{
+    long ret;
+    asm volatile ("syscall" : "=a"(ret) : "a"(num), "D"(arg0), "S"(arg1) : "rcx", "r11", "memory");
+    return ret;
+}
+
+static long syscall3(long num, long arg0, long arg1, long arg2)
+{
+    long ret;
+    asm volatile ("syscall" : "=a"(ret) : "a"(num), "D"(arg0), "S"(arg1), "d"(arg2) : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline uint64_t rdtscp(uint32_t *cpu)
+{
+    uint32_t lo, hi, aux;
+    asm volatile ("rdtscp" : "=a"(lo), "=d"(hi), "=c"(aux) :: "memory");
+    *cpu = aux;
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint32_t read_begin(void)
+{
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&vvar_data.seq, __ATOMIC_ACQUIRE)) & 1)
+        __builtin_ia32_pause();
+    return seq;
+}
+
+static inline int read_retry(uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&vvar_data.seq, __ATOMIC_RELAXED) != seq;
+}
+
+static uint64_t pvclock_ns(void)
+{
+    while (1)
+    {
+        uint32_t cpu, again;
+        rdtscp(&cpu);
+        if (cpu >= VDSO_MAX_CPUS)
+            return 0;
+
+        const volatile struct vdso_pvclock *pv =
+            (const volatile struct vdso_pvclock *)(vvar_pvclock + cpu * VDSO_PAGE_SIZE);
+
+        const uint32_t version = pv->version;
+        if (version & 1)
+            continue;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        unsigned __int128 time = rdtscp(&again) - pv->tsc_timestamp;
+        const int8_t shift = pv->tsc_shift;
+        if (shift >= 0)
+            time <<= shift;
+        else
+            time >>= -shift;
+        time = (time * pv->tsc_to_system_mul) >> 32;
+        time += pv->system_time;
+
+        // each cpu has its own copy, it must be the one we read the tsc on
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (pv->version != version || again != cpu)
+            continue;
+
+        return (uint64_t)time;
+    }
+}
+
+// the main clock, false if the kernel has to be asked
+static int raw_ns(uint64_t *ns)
+{
+    const uint32_t mode = vvar_data.mode;
+    if (mode == vdso_mode_tsc)
+    {
+        uint32_t cpu;
+        const unsigned __int128 tsc = rdtscp(&cpu);
+        if (cpu >= VDSO_MAX_CPUS)
+            return 0;
+
+        *ns = (uint64_t)((tsc * vvar_data.tsc_mult) >> vvar_data.tsc_shift) - vvar_data.cpu_offset[cpu];
+        return 1;
+    }
+    else if (mode == vdso_mode_pvclock)
+    {
+        const uint64_t value = pvclock_ns();
+        if (value == 0)
+            return 0;
+        *ns = value - vvar_data.pvclock_offset;
+        return 1;
+    }
+    return 0;
+}
+
+// same as time::ns
+static int clock_ns(int clockid, uint64_t *ns)
+{
+    uint32_t seq;
+    uint64_t value;
+    do {
+        seq = read_begin();
+
+        // don't need the clock source
+        if (clockid == CLOCK_REALTIME_COARSE || clockid == CLOCK_MONOTONIC_COARSE)
+        {
+            value = vvar_data.coarse_mono;
+            if (clockid == CLOCK_REALTIME_COARSE)
+                value += vvar_data.realtime_offset;
+            continue;
+        }
+
+        uint64_t raw;
+        if (!raw_ns(&raw))
+            return 0;
+
+        if (clockid == CLOCK_MONOTONIC_RAW)
+        {
+            value = raw + vvar_data.raw_offset;
+            continue;
+        }
+
+        const uint64_t raw_last = vvar_data.raw_last;
+        const unsigned __int128 delta = raw > raw_last ? raw - raw_last : 0;
+        value = vvar_data.mono_last + (uint64_t)((delta * vvar_data.mult) >> 32);
+
+        if (clockid == CLOCK_REALTIME)
+            value += vvar_data.realtime_offset;
+        else if (clockid == CLOCK_BOOTTIME)
+            value += vvar_data.boot_offset;
+    } while (read_retry(seq));
+
+    *ns = value;
+    return 1;
+}
+
+export int __vdso_clock_gettime(int clockid, struct timespec *ts)
+{
+    switch (clockid)
+    {
+        case CLOCK_REALTIME:
+        case CLOCK_MONOTONIC:
+        case CLOCK_MONOTONIC_RAW:
+        case CLOCK_REALTIME_COARSE:
+        case CLOCK_MONOTONIC_COARSE:
+        case CLOCK_BOOTTIME:
+        {
+            uint64_t ns;
+            if (!clock_ns(clockid, &ns))
+                break;
+
+            ts->tv_sec = (long)(ns / 1000000000);
+            ts->tv_nsec = (long)(ns % 1000000000);
+            return 0;
+        }
+        default:
+            break;
+    }
+    return (int)syscall2(SYS_clock_gettime, clockid, (long)ts);
+}
+export int clock_gettime(int clockid, struct timespec *ts) alias(__vdso_clock_gettime);
+
+export int __vdso_gettimeofday(struct timeval *tv, struct timezone *tz)
+{
+    uint64_t ns;
+    if (!clock_ns(CLOCK_REALTIME, &ns))
+        return (int)syscall2(SYS_gettimeofday, (long)tv, (long)tz);
+
+    if (tv != 0)
+    {
+        tv->tv_sec = (long)(ns / 1000000000);
+        tv->tv_usec = (long)(ns % 1000000000 / 1000);
+    }
+    if (tz != 0)
+    {
+        tz->tz_minuteswest = 0;
+        tz->tz_dsttime = 0;
+    }
+    return 0;
+}
+export int gettimeofday(struct timeval *tv, struct timezone *tz) alias(__vdso_gettimeofday);
+
+export long __vdso_time(long *tloc)
+{
+    uint64_t ns;
+    if (!clock_ns(CLOCK_REALTIME, &ns))
+        return syscall2(SYS_time, (long)tloc, 0);
+
+    const long secs = (long)(ns / 1000000000);
+    if (tloc != 0)
+        *tloc = secs;
+    return secs;
+}
+export long time(long *tloc) alias(__vdso_time);
+
+export int __vdso_getcpu(unsigned *cpu, unsigned *node, void *unused)
+{
+    if (!vvar_data.has_tsc_aux)
+        return (int)syscall3(SYS_getcpu, (long)cpu, (long)node, (long)unused);
+
+    uint32_t aux;
+    rdtscp(&aux);
+
+    if (cpu != 0)
+        *cpu = aux;
+    if (node != 0)
+        *node = 0;
+    return 0;
+}
+export int getcpu(unsigned *cpu, unsigned *node, void *unused) alias(__vdso_getcpu);